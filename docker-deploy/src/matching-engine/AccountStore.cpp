@@ -0,0 +1,90 @@
+#include "AccountStore.h"
+#include <mutex>
+#include "CustomException.h"
+#include "Journal.h"
+
+std::shared_mutex AccountStore::mutex;
+std::unordered_map<uint32_t, std::unique_ptr<std::atomic<price_t>>> AccountStore::balances;
+
+std::atomic<price_t>* AccountStore::find(uint32_t account_id) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = balances.find(account_id);
+    return found == balances.end() ? nullptr : found->second.get();
+}
+
+void AccountStore::create(uint32_t account_id, price_t balance) {
+    if (balance < 0) {
+        throw CustomException("Balance cannot be negative.");
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (balances.count(account_id) != 0) {
+        throw CustomException("Account already exists.");
+    }
+
+    Event event;
+    event.type = Event::ACCOUNT_CREATED;
+    event.time = Event::now();
+    event.account_id = account_id;
+    event.price = balance;
+    Journal::append(event); //journaled before anyone can see the account (or its balance)
+
+    balances.emplace(account_id, std::unique_ptr<std::atomic<price_t>>(new std::atomic<price_t>(balance)));
+}
+
+bool AccountStore::exists(uint32_t account_id) {
+    return find(account_id) != nullptr;
+}
+
+price_t AccountStore::balance(uint32_t account_id) {
+    std::atomic<price_t>* balance = find(account_id);
+    return balance == nullptr ? 0 : balance->load();
+}
+
+bool AccountStore::reserve(uint32_t account_id, price_t amount) {
+    std::atomic<price_t>* balance = find(account_id);
+    if (balance == nullptr) {
+        return false;
+    }
+
+    price_t current = balance->load();
+    while (current >= amount) {
+        if (balance->compare_exchange_weak(current, current - amount)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AccountStore::credit(uint32_t account_id, price_t amount) {
+    std::atomic<price_t>* balance = find(account_id);
+    if (balance != nullptr) {
+        balance->fetch_add(amount);
+    }
+}
+
+void AccountStore::restore(uint32_t account_id, price_t balance) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    balances[account_id].reset(new std::atomic<price_t>(balance));
+}
+
+std::unique_lock<std::shared_mutex> AccountStore::lock_all() {
+    return std::unique_lock<std::shared_mutex>(mutex);
+}
+
+//count u32, then (account u32, balance i64) per account
+void AccountStore::save(std::string& out) {
+    put<uint32_t>(out, balances.size());
+    for (const auto& account : balances) {
+        put<uint32_t>(out, account.first);
+        put<int64_t>(out, account.second->load());
+    }
+}
+
+void AccountStore::load(BinaryReader& in) {
+    uint32_t count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t account_id = in.get<uint32_t>();
+        restore(account_id, in.get<int64_t>());
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef ACCOUNTSTORE_H
+#define ACCOUNTSTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "Binary.h"
+#include "Price.h"
+
+//authoritative account balances. Accounts are never removed, so a balance is found under a shared lock
+//and then updated with atomics; shards touching the same account never block each other.
+//
+//ordering rule that keeps every prefix of the journal (and so every postgres flush) free of negative
+//balances: credits are journaled before they become visible, debits after they are taken
+class AccountStore {
+public:
+    //throws CustomException if the account exists or the balance is negative
+    static void create(uint32_t account_id, price_t balance);
+
+    static bool exists(uint32_t account_id);
+
+    //current balance, 0 for an unknown account
+    static price_t balance(uint32_t account_id);
+
+    //takes amount from the balance if it covers it
+    static bool reserve(uint32_t account_id, price_t amount);
+
+    static void credit(uint32_t account_id, price_t amount);
+
+    //journal replay: apply without checks or journaling
+    static void restore(uint32_t account_id, price_t balance);
+
+    //blocks account creation and every balance lookup while held (Snapshot takes it with the shards parked)
+    static std::unique_lock<std::shared_mutex> lock_all();
+
+    //snapshot encoding; save() expects lock_all() to be held (or to run in the forked snapshot child)
+    static void save(std::string& out);
+    static void load(BinaryReader& in);
+
+private:
+    static std::shared_mutex mutex;
+    static std::unordered_map<uint32_t, std::unique_ptr<std::atomic<price_t>>> balances;
+
+    static std::atomic<price_t>* find(uint32_t account_id);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//helpers shared by the on-disk formats (Journal, Snapshot). Fields are copied in host byte order, which is
+//little endian on every platform we deploy to
+
+//standard crc32 (same polynomial as zlib), used to detect torn or corrupt data on load
+inline uint32_t crc32(const char* data, size_t length) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+        }
+    } table;
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table.entries[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+inline void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//u8 length + bytes, for symbols
+inline void put_string(std::string& out, const std::string& value) {
+    put<uint8_t>(out, value.size());
+    out.append(value, 0, uint8_t(value.size()));
+}
+
+//reads fields back, throwing instead of running past the end of the data
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t length) : in(data), end(data + length) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+
+    std::string get_string() {
+        size_t length = get<uint8_t>();
+        need(length);
+        std::string value(in, length);
+        in += length;
+        return value;
+    }
+
+    size_t remaining() const {
+        return end - in;
+    }
+
+private:
+    const char* in;
+    const char* end;
+
+    void need(size_t bytes) {
+        if (size_t(end - in) < bytes) {
+            throw std::runtime_error("truncated binary data");
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "BinaryHandler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "Binary.h"
+#include "CustomException.h"
+#include "MatchingEngine.h"
+#include "Metrics.h"
+
+//copies a request onto its struct once its length is checked against the struct's, so a short or padded
+//message can't be read past its end
+template <typename Message>
+static void overlay(const char* message, size_t length, Message& out) {
+    if (length != sizeof(Message)) {
+        throw CustomException("Invalid message length.");
+    }
+    std::memcpy(&out, message, sizeof(Message));
+}
+
+static std::string symbol_of(const char (&symbol)[BINARY_SYMBOL_LENGTH]) {
+    return std::string(symbol, strnlen(symbol, BINARY_SYMBOL_LENGTH));
+}
+
+template <typename Message>
+static Message response(BinaryType type, uint32_t tag) {
+    Message message;
+    std::memset(&message, 0, sizeof(message));
+    message.header.length = sizeof(Message);
+    message.header.type = type;
+    message.header.tag = tag;
+    return message;
+}
+
+void BinaryHandler::execute(const char* message, size_t length, std::string& responses) {
+    BinaryHeader header;
+    std::memcpy(&header, message, sizeof(header));
+
+    std::string error_message;
+    int order_id = 0;
+    OrderStatus status{}; //only read when has_status
+    bool has_status = false;
+    try {
+        switch (header.type) {
+            case BINARY_CREATE_ACCOUNT: {
+                BinaryCreateAccount request;
+                overlay(message, length, request);
+                MatchingEngine::create_account(request.account_id, request.balance);
+                break;
+            }
+            case BINARY_ADD_SHARES: {
+                BinaryAddShares request;
+                overlay(message, length, request);
+                MatchingEngine::insert_shares(request.account_id, symbol_of(request.symbol), request.shares);
+                break;
+            }
+            case BINARY_NEW_ORDER: {
+                BinaryNewOrder request;
+                overlay(message, length, request);
+                order_id = MatchingEngine::place_order(request.account_id, symbol_of(request.symbol), request.amount, request.limit);
+                break;
+            }
+            case BINARY_CANCEL:
+            case BINARY_QUERY: {
+                BinaryOrderRequest request;
+                overlay(message, length, request);
+                order_id = request.order_id;
+                status = header.type == BINARY_CANCEL ? MatchingEngine::cancel_order(request.account_id, request.order_id)
+                                                      : MatchingEngine::query_order(request.account_id, request.order_id);
+                has_status = true;
+                break;
+            }
+            default:
+                throw CustomException("Unknown message type.");
+        }
+
+    } catch (const CustomException& e) {
+        error_message = e.what();
+    } catch (const std::exception &e) {
+        std::cout << "unknown exception in binary request: " << e.what() << std::endl;
+        error_message = "Unexpected error."; //general exception handling
+    }
+
+    switch (header.type) {
+        case BINARY_CREATE_ACCOUNT: Metrics::request(Metrics::ACCOUNT, error_message); break;
+        case BINARY_ADD_SHARES: Metrics::request(Metrics::SHARES, error_message); break;
+        case BINARY_NEW_ORDER: Metrics::request(Metrics::ORDER, error_message); break;
+        case BINARY_CANCEL: Metrics::request(Metrics::CANCEL, error_message); break;
+        case BINARY_QUERY: Metrics::request(Metrics::QUERY, error_message); break;
+        default: break; //not a request
+    }
+
+    append_result(responses, header.tag, order_id, error_message);
+    if (!has_status || !error_message.empty()) {
+        return;
+    }
+
+    BinaryStatus report = response<BinaryStatus>(BINARY_STATUS, header.tag);
+    report.order_id = order_id;
+    report.open_shares = status.open_shares;
+    report.canceled_shares = status.canceled_shares;
+    report.canceled_time = status.canceled_time;
+    report.executions = status.executions.size();
+    put(responses, report);
+
+    for (const Execution& execution : status.executions) {
+        BinaryExecution executed = response<BinaryExecution>(BINARY_EXECUTION, header.tag);
+        executed.order_id = order_id;
+        executed.shares = execution.shares;
+        executed.price = execution.price;
+        executed.time = execution.time;
+        put(responses, executed);
+    }
+}
+
+void BinaryHandler::append_result(std::string& responses, uint32_t tag, int order_id, const std::string& error_message) {
+    BinaryResult result = response<BinaryResult>(BINARY_RESULT, tag);
+    result.ok = error_message.empty();
+    result.order_id = order_id;
+    std::memcpy(result.error, error_message.data(), std::min(error_message.size(), size_t(BINARY_ERROR_LENGTH)));
+    put(responses, result);
+}
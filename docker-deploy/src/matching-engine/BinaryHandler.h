@@ -0,0 +1,19 @@
+#ifndef BINARYHANDLER_H
+#define BINARYHANDLER_H
+
+#include <cstddef>
+#include <string>
+#include "BinaryProtocol.h"
+
+//executes binary protocol requests (BinaryProtocol.h) on the same MatchingEngine operations as the XML
+//requests, appending the response messages
+class BinaryHandler {
+public:
+    //message is one whole request, length bytes as given by its header
+    static void execute(const char* message, size_t length, std::string& responses);
+
+private:
+    static void append_result(std::string& responses, uint32_t tag, int order_id, const std::string& error_message);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef BINARYPROTOCOL_H
+#define BINARYPROTOCOL_H
+
+#include <cstdint>
+
+//fixed layout order entry protocol spoken on Config::binary_port, next to the XML protocol. Every message is
+//one of the packed structs below, little endian, starting with a BinaryHeader whose length is the size of
+//the whole struct. Prices and balances are in Price ticks (1/10000), times in microseconds since epoch.
+//Requests get their responses in order, each carrying the request's tag. Kept free of engine includes so
+//clients (testing/testBinary.cpp) can use it as is
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the binary protocol is little endian on the wire");
+
+#define BINARY_SYMBOL_LENGTH 20 //MAX_SYMBOL_LENGTH; shorter symbols are padded with '\0'
+#define BINARY_ERROR_LENGTH 64 //error text in a result, truncated, '\0' padded
+
+enum BinaryType : uint8_t {
+    //requests
+    BINARY_CREATE_ACCOUNT = 1,
+    BINARY_ADD_SHARES = 2,
+    BINARY_NEW_ORDER = 3,
+    BINARY_CANCEL = 4,
+    BINARY_QUERY = 5,
+
+    //responses
+    BINARY_RESULT = 0x81, //outcome of any request; for successful cancels and queries followed by a status
+    BINARY_STATUS = 0x82, //order state, followed by its executions
+    BINARY_EXECUTION = 0x83
+};
+
+#pragma pack(push, 1)
+
+struct BinaryHeader {
+    uint16_t length; //of the whole message, header included
+    uint8_t type; //BinaryType
+    uint8_t reserved;
+    uint32_t tag; //chosen by the client, copied into the responses
+};
+
+struct BinaryCreateAccount {
+    BinaryHeader header;
+    uint32_t account_id;
+    int64_t balance;
+};
+
+struct BinaryAddShares {
+    BinaryHeader header;
+    uint32_t account_id;
+    char symbol[BINARY_SYMBOL_LENGTH];
+    int64_t shares;
+};
+
+struct BinaryNewOrder {
+    BinaryHeader header;
+    uint32_t account_id;
+    char symbol[BINARY_SYMBOL_LENGTH];
+    int32_t amount; //negative to sell
+    int64_t limit;
+};
+
+//BINARY_CANCEL and BINARY_QUERY
+struct BinaryOrderRequest {
+    BinaryHeader header;
+    uint32_t account_id;
+    int32_t order_id;
+};
+
+struct BinaryResult {
+    BinaryHeader header;
+    uint8_t ok; //1 if accepted, else error holds the reason
+    int32_t order_id; //new order's id, or the id canceled/queried
+    char error[BINARY_ERROR_LENGTH];
+};
+
+struct BinaryStatus {
+    BinaryHeader header;
+    int32_t order_id;
+    int32_t open_shares;
+    int32_t canceled_shares;
+    int64_t canceled_time; //0 unless canceled
+    uint32_t executions; //BINARY_EXECUTION messages that follow
+};
+
+struct BinaryExecution {
+    BinaryHeader header;
+    int32_t order_id;
+    int32_t shares;
+    int64_t price;
+    int64_t time;
+};
+
+#pragma pack(pop)
+
+#endif
@@ -0,0 +1,144 @@
+#include "Config.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+Config::Backend Config::backend = Config::MEMORY;
+Config::Durability Config::durability = Config::PERSISTED;
+size_t Config::persist_batch_size = 1000;
+int Config::io_threads = 8;
+int Config::db_workers = 8;
+bool Config::io_per_thread = false;
+int Config::binary_port = 12346;
+int Config::metrics_port = 12347;
+long Config::group_commit_us = 0;
+size_t Config::group_commit_size = 64;
+bool Config::document_batch = false;
+bool Config::parallel_symbols = true;
+long Config::lock_sample_ms = 10;
+long Config::slow_statement_ms = 100;
+std::string Config::slow_log_path;
+long Config::slow_log_bytes = 16 << 20;
+std::string Config::journal_path;
+bool Config::journal_fsync = true;
+long Config::journal_group_us = 200;
+size_t Config::journal_group_records = 256;
+std::string Config::snapshot_path;
+uint64_t Config::snapshot_events = 1000000;
+
+//value of an environment variable, or nullptr if unset/empty
+static const char* env(const char* name) {
+    const char* value = std::getenv(name);
+    return (value != nullptr && *value != '\0') ? value : nullptr;
+}
+
+void Config::load() {
+    if (const char* value = env("ENGINE_BACKEND")) {
+        std::string name(value);
+        if (name == "memory") {
+            backend = MEMORY;
+        } else if (name == "database") {
+            backend = DATABASE;
+        } else {
+            std::cout << "unknown ENGINE_BACKEND " << name << ", using memory" << std::endl;
+        }
+    }
+
+    if (const char* value = env("ENGINE_DURABILITY")) {
+        std::string level(value);
+        if (level == "buffered") {
+            durability = BUFFERED;
+        } else if (level == "journaled") {
+            durability = JOURNALED;
+        } else if (level == "persisted") {
+            durability = PERSISTED;
+        } else {
+            std::cout << "unknown ENGINE_DURABILITY " << level << ", using persisted" << std::endl;
+        }
+    }
+
+    if (const char* value = env("ENGINE_PERSIST_BATCH")) {
+        persist_batch_size = std::max(1L, std::atol(value));
+    }
+
+    if (const char* value = env("ENGINE_IO_THREADS")) {
+        io_threads = std::max(1, std::atoi(value));
+    }
+    if (const char* value = env("ENGINE_DB_WORKERS")) {
+        db_workers = std::max(1, std::atoi(value));
+    }
+    if (const char* value = env("ENGINE_IO_PER_THREAD")) {
+        io_per_thread = std::atoi(value) != 0;
+    }
+    if (const char* value = env("ENGINE_BINARY_PORT")) {
+        binary_port = std::max(0, std::atoi(value));
+    }
+    if (const char* value = env("ENGINE_METRICS_PORT")) {
+        metrics_port = std::max(0, std::atoi(value));
+    }
+
+    if (const char* value = env("ENGINE_GROUP_COMMIT_US")) {
+        group_commit_us = std::max(0L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_GROUP_COMMIT_SIZE")) {
+        group_commit_size = std::max(1L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_DOCUMENT_BATCH")) {
+        document_batch = std::atoi(value) != 0;
+    }
+    if (const char* value = env("ENGINE_LOCK_SAMPLE_MS")) {
+        lock_sample_ms = std::max(0L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_SLOW_STATEMENT_MS")) {
+        slow_statement_ms = std::max(0L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_SLOW_LOG")) {
+        slow_log_path = value;
+    }
+    if (const char* value = env("ENGINE_SLOW_LOG_BYTES")) {
+        slow_log_bytes = std::max(4096L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_PARALLEL_SYMBOLS")) {
+        parallel_symbols = std::atoi(value) != 0;
+    }
+
+    if (const char* value = env("ENGINE_JOURNAL_PATH")) {
+        journal_path = value;
+    }
+    if (const char* value = env("ENGINE_JOURNAL_FSYNC")) {
+        journal_fsync = std::atoi(value) != 0;
+    }
+    if (const char* value = env("ENGINE_JOURNAL_GROUP_US")) {
+        journal_group_us = std::max(0L, std::atol(value));
+    }
+    if (const char* value = env("ENGINE_JOURNAL_GROUP_RECORDS")) {
+        journal_group_records = std::max(1L, std::atol(value));
+    }
+
+    if (const char* value = env("ENGINE_SNAPSHOT_PATH")) {
+        snapshot_path = value;
+    }
+    if (const char* value = env("ENGINE_SNAPSHOT_EVENTS")) {
+        snapshot_events = std::max(1L, std::atol(value));
+    }
+
+    if (backend == DATABASE) { //every request commits before it is answered, nothing to journal or snapshot
+        durability = PERSISTED;
+        journal_path.clear();
+        snapshot_path.clear();
+    }
+
+    if (durability == JOURNALED && journal_path.empty()) {
+        std::cout << "ENGINE_DURABILITY=journaled needs ENGINE_JOURNAL_PATH, using persisted" << std::endl;
+        durability = PERSISTED;
+    }
+    if (!snapshot_path.empty() && journal_path.empty()) {
+        std::cout << "ENGINE_SNAPSHOT_PATH needs ENGINE_JOURNAL_PATH, snapshots disabled" << std::endl;
+        snapshot_path.clear();
+    }
+
+    const char* names[] = {"buffered", "journaled", "persisted"};
+    std::cout << "backend: " << (backend == MEMORY ? "memory" : "database") << ", durability: " << names[durability] << ", persist batch: " << persist_batch_size
+              << ", journal: " << (journal_path.empty() ? "off" : journal_path)
+              << ", snapshots: " << (snapshot_path.empty() ? "off" : snapshot_path) << std::endl;
+}
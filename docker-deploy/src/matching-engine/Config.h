@@ -0,0 +1,51 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstddef>
+#include <string>
+
+//runtime settings, read once at startup from ENGINE_* environment variables (see docker-compose.yml)
+class Config {
+public:
+    enum Durability {
+        BUFFERED, //ack as soon as the matcher is done
+        JOURNALED, //ack once the request's events are fdatasync'ed to the journal
+        PERSISTED //ack once the request's events are committed in postgres
+    };
+
+    enum Backend {
+        MEMORY, //MatchingEngine holds the state, postgres is a write-behind mirror
+        DATABASE //postgres holds the state, each request is one call of a stored function
+    };
+
+    static Backend backend; //ENGINE_BACKEND=memory|database
+    static Durability durability; //ENGINE_DURABILITY=buffered|journaled|persisted, MEMORY backend only
+    static size_t persist_batch_size; //ENGINE_PERSIST_BATCH, max events per write-behind flush
+
+    static int io_threads; //ENGINE_IO_THREADS, threads running the sockets
+    static int db_workers; //ENGINE_DB_WORKERS, threads running requests (and with the DATABASE backend connections)
+    static bool io_per_thread; //ENGINE_IO_PER_THREAD=1: an io_context and SO_REUSEPORT acceptor per io thread
+    static int binary_port; //ENGINE_BINARY_PORT, listener for the binary protocol (BinaryProtocol.h), 0 disables it
+    static int metrics_port; //ENGINE_METRICS_PORT, HTTP endpoint of MetricsServer, 0 disables it
+
+    static long group_commit_us; //ENGINE_GROUP_COMMIT_US, DATABASE backend: batch window of GroupCommit, 0 disables it
+    static size_t group_commit_size; //ENGINE_GROUP_COMMIT_SIZE, batch closes early once this many calls wait
+    static bool document_batch; //ENGINE_DOCUMENT_BATCH=1, DATABASE backend: one transaction per request document
+    static long lock_sample_ms; //ENGINE_LOCK_SAMPLE_MS, DATABASE backend: lock wait sampling interval, 0 disables it
+    static long slow_statement_ms; //ENGINE_SLOW_STATEMENT_MS, statements at least this slow are logged, 0 disables it
+    static std::string slow_log_path; //ENGINE_SLOW_LOG, the slow statement log, empty disables it
+    static long slow_log_bytes; //ENGINE_SLOW_LOG_BYTES, size at which the log is rotated to <path>.1
+    static bool parallel_symbols; //ENGINE_PARALLEL_SYMBOLS=0 runs the orders of a request strictly one by one
+
+    static std::string journal_path; //ENGINE_JOURNAL_PATH, empty disables the journal (state resets on restart)
+    static bool journal_fsync; //ENGINE_JOURNAL_FSYNC=0 leaves flushing to the OS
+    static long journal_group_us; //ENGINE_JOURNAL_GROUP_US, how long a journal flush waits for more records
+    static size_t journal_group_records; //ENGINE_JOURNAL_GROUP_RECORDS, flush without waiting once this many are pending
+
+    static std::string snapshot_path; //ENGINE_SNAPSHOT_PATH, empty disables snapshots (needs the journal)
+    static uint64_t snapshot_events; //ENGINE_SNAPSHOT_EVENTS, journal events between snapshots
+
+    static void load();
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "DatabaseTelemetry.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include "Config.h"
+
+std::mutex DatabaseTelemetry::mutex;
+std::unordered_map<int, DatabaseTelemetry::Running> DatabaseTelemetry::running;
+std::map<std::string, std::chrono::microseconds> DatabaseTelemetry::symbol_waits;
+std::map<std::string, std::chrono::microseconds> DatabaseTelemetry::statement_waits;
+uint64_t DatabaseTelemetry::retries[RETRY_COUNT];
+std::mutex DatabaseTelemetry::log_mutex;
+FILE* DatabaseTelemetry::log = nullptr;
+long DatabaseTelemetry::log_bytes = 0;
+bool DatabaseTelemetry::running_sampler = false;
+std::condition_variable DatabaseTelemetry::stopped;
+std::thread DatabaseTelemetry::sampler;
+
+static const char* RETRY_NAMES[] = {"deadlock", "serialization"};
+
+DatabaseTelemetry::Statement::Statement(const char* name, LatencyStats::RequestType type, const std::string& symbol, int pid)
+    : name(name), type(type), pid(pid), start(LatencyStats::Clock::now()) {
+    std::lock_guard<std::mutex> lock(mutex);
+    running[pid] = Running{name, symbol, std::chrono::microseconds(0)};
+}
+
+DatabaseTelemetry::Statement::~Statement() {
+    LatencyStats::Clock::duration elapsed = LatencyStats::Clock::now() - start;
+    LatencyStats::record(LatencyStats::STATEMENT, type, elapsed);
+
+    Running finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = running.find(pid);
+        finished = std::move(found->second);
+        running.erase(found);
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    if (Config::slow_statement_ms > 0 && elapsed_ms >= Config::slow_statement_ms) {
+        log_slow(name, finished.symbol, elapsed_ms, finished.lock_wait);
+    }
+}
+
+void DatabaseTelemetry::start(db_ptr sampler_conn) {
+    if (!Config::slow_log_path.empty()) {
+        log = fopen(Config::slow_log_path.c_str(), "a");
+        if (log == nullptr) {
+            std::cout << "cannot open slow statement log " << Config::slow_log_path << ": " << std::strerror(errno) << std::endl;
+        } else {
+            log_bytes = ftell(log);
+        }
+    }
+
+    if (sampler_conn && Config::lock_sample_ms > 0) {
+        running_sampler = true;
+        sampler = std::thread(&DatabaseTelemetry::sample, sampler_conn);
+        std::cout << "sampling lock waits every " << Config::lock_sample_ms << "ms" << std::endl;
+    }
+}
+
+void DatabaseTelemetry::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running_sampler = false;
+    }
+    stopped.notify_all();
+    if (sampler.joinable()) {
+        sampler.join();
+    }
+
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log != nullptr) {
+        fclose(log);
+        log = nullptr;
+    }
+}
+
+void DatabaseTelemetry::retried(Retry kind) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retries[kind]++;
+}
+
+void DatabaseTelemetry::committed(LatencyStats::RequestType type, LatencyStats::Clock::time_point start) {
+    LatencyStats::record_since(LatencyStats::COMMIT, type, start);
+}
+
+//every backend found waiting for a lock gets the whole interval charged, so the totals are estimates with
+//the interval as resolution. The query itself is cheap: pg_stat_activity is shared memory, no locks taken
+void DatabaseTelemetry::sample(db_ptr conn) {
+    std::chrono::microseconds interval = std::chrono::milliseconds(Config::lock_sample_ms);
+    std::vector<int> waiting;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopped.wait_for(lock, interval, []() { return !running_sampler; });
+            if (!running_sampler) {
+                return;
+            }
+        }
+
+        waiting.clear();
+        try {
+            pqxx::nontransaction N(*conn);
+            for (const pqxx::row& row : N.exec("SELECT pid FROM pg_stat_activity WHERE wait_event_type = 'Lock';")) {
+                waiting.push_back(row[0].as<int>());
+            }
+        } catch (const std::exception& e) {
+            std::cout << "lock wait sampling failed: " << e.what() << std::endl;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int pid : waiting) {
+            auto found = running.find(pid);
+            if (found == running.end()) {
+                continue; //not ours, or done since
+            }
+            found->second.lock_wait += interval;
+            statement_waits[found->second.statement] += interval;
+            if (!found->second.symbol.empty()) {
+                symbol_waits[found->second.symbol] += interval;
+            }
+        }
+    }
+}
+
+//one line per statement: local time, statement, symbol, elapsed and sampled lock wait in ms. The log is
+//renamed to <path>.1 (replacing the previous one) once it reaches Config::slow_log_bytes
+void DatabaseTelemetry::log_slow(const char* statement, const std::string& symbol, double elapsed_ms, std::chrono::microseconds lock_wait) {
+    char time_text[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(time_text, sizeof(time_text), "%Y-%m-%d %H:%M:%S", &local);
+
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log == nullptr) {
+        return;
+    }
+    int written = fprintf(log, "%s %s symbol=%s elapsed_ms=%.3f lock_wait_ms=%lld\n", time_text, statement,
+                          symbol.empty() ? "-" : symbol.c_str(), elapsed_ms, (long long)(lock_wait.count() / 1000));
+    fflush(log);
+    log_bytes += std::max(0, written);
+
+    if (log_bytes >= Config::slow_log_bytes) {
+        fclose(log);
+        std::string rotated = Config::slow_log_path + ".1";
+        rename(Config::slow_log_path.c_str(), rotated.c_str());
+        log = fopen(Config::slow_log_path.c_str(), "a");
+        log_bytes = 0;
+    }
+}
+
+//symbols by lock wait, most first
+static std::vector<std::pair<std::string, std::chrono::microseconds>> hottest(const std::map<std::string, std::chrono::microseconds>& waits, size_t count) {
+    std::vector<std::pair<std::string, std::chrono::microseconds>> sorted(waits.begin(), waits.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    sorted.resize(std::min(sorted.size(), count));
+    return sorted;
+}
+
+void DatabaseTelemetry::render(std::string& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    char line[160];
+
+    out += "# HELP engine_db_retries_total Calls run again after postgres aborted them.\n# TYPE engine_db_retries_total counter\n";
+    for (int kind = 0; kind < RETRY_COUNT; kind++) {
+        snprintf(line, sizeof(line), "engine_db_retries_total{kind=\"%s\"} %llu\n", RETRY_NAMES[kind], (unsigned long long)retries[kind]);
+        out += line;
+    }
+
+    out += "# HELP engine_db_statement_lock_wait_seconds_total Sampled time statements spent waiting on row locks.\n"
+           "# TYPE engine_db_statement_lock_wait_seconds_total counter\n";
+    for (const auto& wait : statement_waits) {
+        snprintf(line, sizeof(line), "engine_db_statement_lock_wait_seconds_total{statement=\"%s\"} %.6f\n",
+                 wait.first.c_str(), wait.second.count() / 1e6);
+        out += line;
+    }
+
+    //symbols are validated to be short, and quotes in them are escaped
+    out += "# HELP engine_db_symbol_lock_wait_seconds_total Sampled lock wait of the hottest symbols.\n"
+           "# TYPE engine_db_symbol_lock_wait_seconds_total counter\n";
+    for (const auto& wait : hottest(symbol_waits, HOT_SYMBOLS)) {
+        std::string symbol;
+        for (char c : wait.first) {
+            if (c == '"' || c == '\\') {
+                symbol += '\\';
+            }
+            symbol += c == '\n' ? ' ' : c;
+        }
+        snprintf(line, sizeof(line), "engine_db_symbol_lock_wait_seconds_total{symbol=\"%s\"} %.6f\n",
+                 symbol.c_str(), wait.second.count() / 1e6);
+        out += line;
+    }
+}
+
+std::string DatabaseTelemetry::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (symbol_waits.empty() && statement_waits.empty()) {
+        return "";
+    }
+
+    std::string out = "lock wait in ms (sampled):\n";
+    char line[160];
+    for (const auto& wait : hottest(statement_waits, statement_waits.size())) {
+        snprintf(line, sizeof(line), "statement %-20s %12.1f\n", wait.first.c_str(), wait.second.count() / 1e3);
+        out += line;
+    }
+    for (const auto& wait : hottest(symbol_waits, HOT_SYMBOLS)) {
+        snprintf(line, sizeof(line), "symbol    %-20s %12.1f\n", wait.first.c_str(), wait.second.count() / 1e3);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "retries: %llu deadlock, %llu serialization\n",
+             (unsigned long long)retries[DEADLOCK], (unsigned long long)retries[SERIALIZATION]);
+    out += line;
+    return out;
+}
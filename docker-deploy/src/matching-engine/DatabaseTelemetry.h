@@ -0,0 +1,79 @@
+#ifndef DATABASETELEMETRY_H
+#define DATABASETELEMETRY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <pqxx/pqxx>
+#include "LatencyStats.h"
+
+#define HOT_SYMBOLS 20 //symbols reported by lock wait
+
+//where the DATABASE backend's time in postgres goes. Every statement and commit is timed into LatencyStats
+//(STATEMENT and COMMIT stages), deadlock/serialization retries are counted, and statements slower than
+//Config::slow_statement_ms are written to a size rotated log. A sampler on its own connection polls
+//pg_stat_activity for backends waiting on a lock and charges the sample interval to the symbol and
+//statement that backend is running, which tells the hottest symbols apart from merely slow ones
+class DatabaseTelemetry {
+public:
+    typedef std::shared_ptr<pqxx::connection> db_ptr;
+
+    enum Retry { DEADLOCK, SERIALIZATION, RETRY_COUNT };
+
+    //times one statement while it is in scope and makes it visible to the sampler. pid is the backend running
+    //it (connection backendpid()), which libpqxx 6 and 7 both have on every connection type
+    class Statement {
+    public:
+        Statement(const char* name, LatencyStats::RequestType type, const std::string& symbol, int pid);
+        ~Statement();
+
+    private:
+        const char* name;
+        LatencyStats::RequestType type;
+        int pid; //backend running it
+        LatencyStats::Clock::time_point start;
+    };
+
+    //sampler (if Config::lock_sample_ms) and slow statement log (if Config::slow_log_path)
+    static void start(db_ptr sampler_conn);
+    static void stop();
+
+    static void retried(Retry kind);
+    static void committed(LatencyStats::RequestType type, LatencyStats::Clock::time_point start);
+
+    //Prometheus lines for Metrics, and a table of the hottest symbols for the stats dump
+    static void render(std::string& out);
+    static std::string report();
+
+private:
+    struct Running { //what a backend is doing, for the sampler
+        const char* statement;
+        std::string symbol;
+        std::chrono::microseconds lock_wait; //sampled so far
+    };
+
+    static std::mutex mutex; //guards everything below but the log
+    static std::unordered_map<int, Running> running; //by backend pid
+    static std::map<std::string, std::chrono::microseconds> symbol_waits;
+    static std::map<std::string, std::chrono::microseconds> statement_waits;
+    static uint64_t retries[RETRY_COUNT];
+
+    static std::mutex log_mutex;
+    static FILE* log;
+    static long log_bytes;
+
+    static bool running_sampler;
+    static std::condition_variable stopped;
+    static std::thread sampler;
+
+    static void sample(db_ptr conn);
+    static void log_slow(const char* statement, const std::string& symbol, double elapsed_ms, std::chrono::microseconds lock_wait);
+};
+
+#endif
@@ -2,61 +2,256 @@
 #include <pqxx/pqxx>
 #include <exception>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <utility>
 #include "CustomException.h"
-#include <algorithm>
-#include <thread>
-#include <chrono>
+#include "DatabaseTelemetry.h"
+#include "GroupCommit.h"
+#include "LatencyStats.h"
+#include "Metrics.h"
 
 extern thread_local std::shared_ptr<pqxx::connection> thread_conn; //make thread local db connection visible
 
-void DatabaseTransactions::setup() {
-    //RESET AND SETUP TABLES HERE
+#define DEADLOCK_ATTEMPTS 5
+
+//DATABASE backend: matching runs inside postgres, one function call per request. Rejections come back in the
+//error column (nothing has been written by then); the first row of engine_match_order is the new order, the
+//rest are its fills. Incoming orders and cancels on a symbol are serialized with an advisory lock, so two
+//crossing orders can't miss each other and a cancel can't refund shares a match is filling
+static void install_functions(pqxx::work& W) {
+    W.exec(R"SQL(
+CREATE OR REPLACE FUNCTION engine_match_order(p_account BIGINT, p_symbol VARCHAR, p_amount INTEGER, p_limit BIGINT)
+RETURNS TABLE(order_id INTEGER, error TEXT, shares INTEGER, price BIGINT) AS $$
+#variable_conflict use_column
+DECLARE
+    v_balance BIGINT;
+    v_held BIGINT;
+    v_order INTEGER;
+    v_remaining INTEGER := abs(p_amount);
+    v_resting RECORD;
+    v_shares INTEGER;
+BEGIN
+    IF p_limit <= 0 THEN
+        RETURN QUERY SELECT NULL::INTEGER, 'Invalid limit price.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+        RETURN;
+    END IF;
+    PERFORM pg_advisory_xact_lock(hashtext(p_symbol));
+
+    IF p_amount >= 0 THEN
+        SELECT balance INTO v_balance FROM Accounts WHERE account_id = p_account FOR UPDATE;
+        IF NOT FOUND THEN
+            RETURN QUERY SELECT NULL::INTEGER, 'Account does not exist.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+            RETURN;
+        END IF;
+        IF v_balance < p_amount::NUMERIC * p_limit THEN
+            RETURN QUERY SELECT NULL::INTEGER, 'Insufficient balance.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+            RETURN;
+        END IF;
+        UPDATE Accounts SET balance = balance - p_amount::BIGINT * p_limit WHERE account_id = p_account;
+    ELSE
+        PERFORM 1 FROM Accounts WHERE account_id = p_account;
+        IF NOT FOUND THEN
+            RETURN QUERY SELECT NULL::INTEGER, 'Account does not exist.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+            RETURN;
+        END IF;
+        SELECT amount INTO v_held FROM Holdings WHERE account_id = p_account AND symbol = p_symbol FOR UPDATE;
+        IF NOT FOUND THEN
+            RETURN QUERY SELECT NULL::INTEGER, 'Account does not own shares of this symbol.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+            RETURN;
+        END IF;
+        IF v_held < -p_amount::BIGINT THEN
+            RETURN QUERY SELECT NULL::INTEGER, 'Insufficient currently owned shares of this symbol.'::TEXT, NULL::INTEGER, NULL::BIGINT;
+            RETURN;
+        END IF;
+        UPDATE Holdings SET amount = amount + p_amount WHERE account_id = p_account AND symbol = p_symbol;
+    END IF;
+
+    INSERT INTO Orders (order_id, account_id, symbol, original_shares, open_shares, limit_price)
+    VALUES (nextval('order_ids'), p_account, p_symbol, p_amount, p_amount, p_limit)
+    RETURNING Orders.order_id INTO v_order;
+    RETURN QUERY SELECT v_order, NULL::TEXT, NULL::INTEGER, NULL::BIGINT;
+
+    --best price first, oldest first within a price; fills happen at the resting order's limit
+    IF p_amount > 0 THEN
+        FOR v_resting IN
+            SELECT o.order_id, o.account_id, o.open_shares, o.limit_price FROM Orders o
+            WHERE o.symbol = p_symbol AND o.open_shares < 0 AND o.limit_price <= p_limit
+            ORDER BY o.limit_price, o.order_id
+        LOOP
+            EXIT WHEN v_remaining = 0;
+            v_shares := least(v_remaining, -v_resting.open_shares);
+            INSERT INTO Holdings (account_id, symbol, amount) VALUES (p_account, p_symbol, v_shares)
+                ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;
+            UPDATE Accounts SET balance = balance + v_shares::BIGINT * v_resting.limit_price WHERE account_id = v_resting.account_id;
+            UPDATE Orders SET open_shares = open_shares - v_shares WHERE order_id = v_order;
+            UPDATE Orders SET open_shares = open_shares + v_shares WHERE order_id = v_resting.order_id;
+            INSERT INTO Trades (buy_order_id, sell_order_id, symbol, traded_shares, price)
+                VALUES (v_order, v_resting.order_id, p_symbol, v_shares, v_resting.limit_price);
+            v_remaining := v_remaining - v_shares;
+            RETURN QUERY SELECT v_order, NULL::TEXT, v_shares, v_resting.limit_price;
+        END LOOP;
+    ELSIF p_amount < 0 THEN
+        FOR v_resting IN
+            SELECT o.order_id, o.account_id, o.open_shares, o.limit_price FROM Orders o
+            WHERE o.symbol = p_symbol AND o.open_shares > 0 AND o.limit_price >= p_limit
+            ORDER BY o.limit_price DESC, o.order_id
+        LOOP
+            EXIT WHEN v_remaining = 0;
+            v_shares := least(v_remaining, v_resting.open_shares);
+            INSERT INTO Holdings (account_id, symbol, amount) VALUES (v_resting.account_id, p_symbol, v_shares)
+                ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;
+            UPDATE Accounts SET balance = balance + v_shares::BIGINT * v_resting.limit_price WHERE account_id = p_account;
+            UPDATE Orders SET open_shares = open_shares + v_shares WHERE order_id = v_order;
+            UPDATE Orders SET open_shares = open_shares - v_shares WHERE order_id = v_resting.order_id;
+            INSERT INTO Trades (buy_order_id, sell_order_id, symbol, traded_shares, price)
+                VALUES (v_resting.order_id, v_order, p_symbol, v_shares, v_resting.limit_price);
+            v_remaining := v_remaining - v_shares;
+            RETURN QUERY SELECT v_order, NULL::TEXT, v_shares, v_resting.limit_price;
+        END LOOP;
+    END IF;
+END;
+$$ LANGUAGE plpgsql;)SQL");
+
+    //first row is the order (open, canceled, cancel time), the rest its executions; times in microseconds
+    W.exec(R"SQL(
+CREATE OR REPLACE FUNCTION engine_order_status(p_account BIGINT, p_order INTEGER)
+RETURNS TABLE(error TEXT, open_shares INTEGER, canceled_shares INTEGER, canceled_time BIGINT,
+              exec_shares INTEGER, exec_price BIGINT, exec_time BIGINT) AS $$
+#variable_conflict use_column
+DECLARE
+    v_order RECORD;
+    v_executed BIGINT;
+BEGIN
+    PERFORM 1 FROM Accounts WHERE account_id = p_account;
+    IF NOT FOUND THEN
+        RETURN QUERY SELECT 'Account does not exist.'::TEXT, NULL::INTEGER, NULL::INTEGER, NULL::BIGINT, NULL::INTEGER, NULL::BIGINT, NULL::BIGINT;
+        RETURN;
+    END IF;
+    SELECT * INTO v_order FROM Orders WHERE order_id = p_order AND account_id = p_account;
+    IF NOT FOUND THEN
+        RETURN QUERY SELECT 'Transaction with given id does not exist.'::TEXT, NULL::INTEGER, NULL::INTEGER, NULL::BIGINT, NULL::INTEGER, NULL::BIGINT, NULL::BIGINT;
+        RETURN;
+    END IF;
+
+    SELECT COALESCE(sum(traded_shares), 0) INTO v_executed FROM Trades WHERE buy_order_id = p_order OR sell_order_id = p_order;
+    RETURN QUERY SELECT NULL::TEXT, v_order.open_shares,
+        (abs(v_order.original_shares) - abs(v_order.open_shares) - v_executed)::INTEGER, --what was neither filled nor is still open
+        (extract(epoch FROM v_order.timestamp) * 1000000)::BIGINT, NULL::INTEGER, NULL::BIGINT, NULL::BIGINT;
+    RETURN QUERY SELECT NULL::TEXT, NULL::INTEGER, NULL::INTEGER, NULL::BIGINT,
+        t.traded_shares, t.price, (extract(epoch FROM t.timestamp) * 1000000)::BIGINT
+        FROM Trades t WHERE t.buy_order_id = p_order OR t.sell_order_id = p_order ORDER BY t.trade_id;
+END;
+$$ LANGUAGE plpgsql;)SQL");
+
+    W.exec(R"SQL(
+CREATE OR REPLACE FUNCTION engine_cancel_order(p_account BIGINT, p_order INTEGER)
+RETURNS TABLE(error TEXT, open_shares INTEGER, canceled_shares INTEGER, canceled_time BIGINT,
+              exec_shares INTEGER, exec_price BIGINT, exec_time BIGINT) AS $$
+#variable_conflict use_column
+DECLARE
+    v_order RECORD;
+    v_symbol VARCHAR;
+BEGIN
+    --the symbol's lock first, as engine_match_order takes it, so a match can't fill the order between this
+    --read and the refund; the order is only read once the lock is held
+    SELECT symbol INTO v_symbol FROM Orders WHERE order_id = p_order AND account_id = p_account;
+    IF FOUND THEN
+        PERFORM pg_advisory_xact_lock(hashtext(v_symbol));
+    END IF;
+    SELECT * INTO v_order FROM Orders WHERE order_id = p_order AND account_id = p_account FOR UPDATE;
+    IF NOT FOUND THEN
+        RETURN QUERY SELECT * FROM engine_order_status(p_account, p_order); --reports the missing account/order
+        RETURN;
+    END IF;
+    IF v_order.open_shares = 0 THEN
+        RETURN QUERY SELECT 'Transaction already fully executed or canceled.'::TEXT, NULL::INTEGER, NULL::INTEGER, NULL::BIGINT, NULL::INTEGER, NULL::BIGINT, NULL::BIGINT;
+        RETURN;
+    END IF;
+
+    IF v_order.open_shares > 0 THEN --refund reserved cash
+        UPDATE Accounts SET balance = balance + v_order.open_shares::BIGINT * v_order.limit_price WHERE account_id = p_account;
+    ELSE --refund reserved shares
+        INSERT INTO Holdings (account_id, symbol, amount) VALUES (p_account, v_order.symbol, -v_order.open_shares)
+            ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;
+    END IF;
+    UPDATE Orders SET open_shares = 0, timestamp = now() WHERE order_id = p_order;
+
+    RETURN QUERY SELECT * FROM engine_order_status(p_account, p_order);
+END;
+$$ LANGUAGE plpgsql;)SQL");
+}
+
+//with the MEMORY backend postgres is a write-behind mirror of the engine's state (see PersistenceWriter).
+//Without a journal the engine starts empty, so the mirror is reset to match; with one, the tables are kept
+//and caught up from the journal
+void DatabaseTransactions::setup(bool reset) {
     //dont think i need to setup a transaction as only 1 thread here
     try {
         pqxx::work W(*thread_conn);
     
-        //drop existing tables to reset
-        W.exec("DROP TABLE IF EXISTS Trades CASCADE;");
-        W.exec("DROP TABLE IF EXISTS Orders CASCADE;");
-        W.exec("DROP TABLE IF EXISTS Holdings CASCADE;");
-        W.exec("DROP TABLE IF EXISTS Accounts CASCADE;");
+        if (reset) {
+            //drop existing tables to reset
+            W.exec("DROP TABLE IF EXISTS Trades CASCADE;");
+            W.exec("DROP TABLE IF EXISTS Orders CASCADE;");
+            W.exec("DROP TABLE IF EXISTS Holdings CASCADE;");
+            W.exec("DROP TABLE IF EXISTS Accounts CASCADE;");
+            W.exec("DROP TABLE IF EXISTS EngineState CASCADE;");
+            W.exec("DROP SEQUENCE IF EXISTS order_ids;");
+        }
+
+        W.exec("CREATE SEQUENCE IF NOT EXISTS order_ids;"); //order ids of the DATABASE backend
     
         //accounts table
-        W.exec("CREATE TABLE Accounts ("
+        W.exec("CREATE TABLE IF NOT EXISTS Accounts ("
                "account_id BIGINT PRIMARY KEY,"
-               "balance FLOAT NOT NULL CHECK (balance >= 0));");
+               "balance BIGINT NOT NULL CHECK (balance >= 0));"); //fixed point, see Price.h
     
         //orders table
-        W.exec("CREATE TABLE Orders ("
-               "order_id SERIAL PRIMARY KEY,"
+        W.exec("CREATE TABLE IF NOT EXISTS Orders ("
+               "order_id INTEGER PRIMARY KEY," //assigned by the engine
                "account_id BIGINT,"
                "symbol VARCHAR(20) NOT NULL,"
                "original_shares INTEGER NOT NULL," //amount of shares initially requested (buy = positive, sell = negative)
                "open_shares INTEGER NOT NULL,"  //amount of shares open (buy = positive, sell = negative)
-               "limit_price FLOAT NOT NULL,"  //user given limit price
-               "timestamp TIMESTAMP DEFAULT now()," //when order arrived
+               "limit_price BIGINT NOT NULL,"  //user given limit price, fixed point
+               "timestamp TIMESTAMP DEFAULT now()," //when order arrived, or when it was canceled
                "FOREIGN KEY (account_id) REFERENCES ACCOUNTS(account_id) ON DELETE CASCADE);");
     
         //executed trades table
-        W.exec("CREATE TABLE Trades ("
+        W.exec("CREATE TABLE IF NOT EXISTS Trades ("
                "trade_id SERIAL PRIMARY KEY,"
                "buy_order_id INTEGER,"
                "sell_order_id INTEGER,"
                "symbol VARCHAR(20) NOT NULL,"
                "traded_shares INTEGER NOT NULL," //how many shares were traded in this trade (could be partial execution)
-               "price FLOAT NOT NULL," //price the trade was executed at
+               "price BIGINT NOT NULL," //price the trade was executed at, fixed point
                "timestamp TIMESTAMP DEFAULT now(),"
                "FOREIGN KEY (buy_order_id) REFERENCES ORDERS(order_id) ON DELETE SET NULL," //setting NULL on delete of the connected order_id, might need to CASCADE
                "FOREIGN KEY (sell_order_id) REFERENCES ORDERS(order_id) ON DELETE SET NULL);");
     
         //holdings (symbol ownership) table
-        W.exec("CREATE TABLE Holdings ("
+        W.exec("CREATE TABLE IF NOT EXISTS Holdings ("
                "id SERIAL PRIMARY KEY,"
                "account_id BIGINT,"
                "symbol VARCHAR(20) NOT NULL,"
-               "amount INTEGER NOT NULL CHECK (amount >= 0),"
+               "amount BIGINT NOT NULL CHECK (amount >= 0),"
                "FOREIGN KEY (account_id) REFERENCES ACCOUNTS(account_id) ON DELETE CASCADE,"
                "UNIQUE (account_id, symbol));");
+
+        //open orders by book priority, for the DATABASE backend's crossing scan
+        W.exec("CREATE INDEX IF NOT EXISTS orders_open_sells ON Orders (symbol, limit_price, order_id) WHERE open_shares < 0;");
+        W.exec("CREATE INDEX IF NOT EXISTS orders_open_buys ON Orders (symbol, limit_price DESC, order_id) WHERE open_shares > 0;");
+        W.exec("CREATE INDEX IF NOT EXISTS trades_buy_order ON Trades (buy_order_id);");
+        W.exec("CREATE INDEX IF NOT EXISTS trades_sell_order ON Trades (sell_order_id);");
+
+        //last journal seq contained in the tables above, updated in the same transaction as every flush
+        W.exec("CREATE TABLE IF NOT EXISTS EngineState ("
+               "id INTEGER PRIMARY KEY CHECK (id = 1),"
+               "persisted_seq BIGINT NOT NULL);");
+        W.exec("INSERT INTO EngineState (id, persisted_seq) VALUES (1, 0) ON CONFLICT (id) DO NOTHING;");
+
+        install_functions(W);
     
         W.commit();
         std::cout << "successfully setup db tables" << std::endl;
@@ -66,360 +261,459 @@ void DatabaseTransactions::setup() {
     }
 }
 
-int DatabaseTransactions::create_account(uint32_t account_id, float start_balance) {
-    pqxx::work W(*thread_conn);
-    
-    W.exec_params("INSERT INTO Accounts (account_id, balance) VALUES ($1, $2);",
-                    account_id, start_balance);
-    
-    W.commit();
-    return 1; //success if didn't throw (should get caught in caller)
-}
 
-//only support inserting int number of shares, might need to extend to partial shares?
-int DatabaseTransactions::insert_shares(uint32_t account_id, std::string& symbol, int amount) {
-    pqxx::work W(*thread_conn);
-
-    pqxx::result holdingRes = W.exec_params(
+//statement set of the write-behind flush, prepared once per connection. Each takes a whole column of the
+//batch as one array parameter, so the statement text (and its plan) is the same for every batch size
+void DatabaseTransactions::prepare(pqxx::connection& conn) {
+    conn.prepare("insert_accounts",
+        "INSERT INTO Accounts (account_id, balance) "
+        "SELECT * FROM unnest($1::BIGINT[], $2::BIGINT[]);");
+
+    conn.prepare("update_balances",
+        "UPDATE Accounts AS a SET balance = a.balance + v.delta "
+        "FROM unnest($1::BIGINT[], $2::BIGINT[]) AS v(account_id, delta) "
+        "WHERE a.account_id = v.account_id;");
+
+    conn.prepare("add_holdings",
+        "INSERT INTO Holdings (account_id, symbol, amount) "
+        "SELECT * FROM unnest($1::BIGINT[], $2::VARCHAR[], $3::BIGINT[]) "
+        "ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;");
+
+    conn.prepare("remove_holdings",
+        "UPDATE Holdings AS h SET amount = h.amount + v.delta "
+        "FROM unnest($1::BIGINT[], $2::VARCHAR[], $3::BIGINT[]) AS v(account_id, symbol, delta) "
+        "WHERE h.account_id = v.account_id AND h.symbol = v.symbol;");
+
+    //times are microseconds since epoch
+    conn.prepare("insert_orders",
+        "INSERT INTO Orders (order_id, account_id, symbol, original_shares, open_shares, limit_price, timestamp) "
+        "SELECT v.order_id, v.account_id, v.symbol, v.shares, v.shares, v.limit_price, to_timestamp(v.time / 1000000.0) "
+        "FROM unnest($1::INTEGER[], $2::BIGINT[], $3::VARCHAR[], $4::INTEGER[], $5::BIGINT[], $6::BIGINT[]) "
+        "AS v(order_id, account_id, symbol, shares, limit_price, time);");
+
+    //canceled = 0 keeps the timestamp, anything else is the cancel time
+    conn.prepare("update_orders",
+        "UPDATE Orders AS o SET open_shares = o.open_shares + v.delta, "
+        "timestamp = CASE WHEN v.canceled = 0 THEN o.timestamp ELSE to_timestamp(v.canceled / 1000000.0)::TIMESTAMP END "
+        "FROM unnest($1::INTEGER[], $2::INTEGER[], $3::BIGINT[]) AS v(order_id, delta, canceled) "
+        "WHERE o.order_id = v.order_id;");
+
+    conn.prepare("insert_trades",
+        "INSERT INTO Trades (buy_order_id, sell_order_id, symbol, traded_shares, price, timestamp) "
+        "SELECT v.buy_order_id, v.sell_order_id, v.symbol, v.shares, v.price, to_timestamp(v.time / 1000000.0) "
+        "FROM unnest($1::INTEGER[], $2::INTEGER[], $3::VARCHAR[], $4::INTEGER[], $5::BIGINT[], $6::BIGINT[]) "
+        "AS v(buy_order_id, sell_order_id, symbol, shares, price, time);");
+
+    conn.prepare("set_persisted_seq", "UPDATE EngineState SET persisted_seq = $1 WHERE id = 1;");
+    conn.prepare("get_persisted_seq", "SELECT persisted_seq FROM EngineState WHERE id = 1;");
+
+    //DATABASE backend
+    conn.prepare("create_account", "INSERT INTO Accounts (account_id, balance) VALUES ($1, $2);");
+    conn.prepare("insert_shares",
         "INSERT INTO Holdings (account_id, symbol, amount) VALUES ($1, $2, $3) "
-            "ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;", //make sure to acquire row lock
-        account_id, symbol, amount
-    );
-
-    W.commit();
-    return 1;
+        "ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;");
+    conn.prepare("match_order", "SELECT * FROM engine_match_order($1, $2, $3, $4);");
+    conn.prepare("order_status", "SELECT * FROM engine_order_status($1, $2);");
+    conn.prepare("cancel_order", "SELECT * FROM engine_cancel_order($1, $2);");
+    conn.prepare("account_balance", "SELECT balance FROM Accounts WHERE account_id = $1;");
+
+    //a whole <create> (kind 0 account, 1 shares) in document order. An account is created by the first item
+    //for its id unless it existed before; shares need an account that existed before or was created by an
+    //earlier item. The CTEs all see the tables as they were before the statement, and the share inserts
+    //are summed per holding into one row. Returns the rejected items with their error
+    conn.prepare("create_batch",
+        "WITH items AS ("
+        "  SELECT * FROM unnest($1::INTEGER[], $2::BIGINT[], $3::VARCHAR[], $4::BIGINT[]) WITH ORDINALITY "
+        "  AS v(kind, account_id, symbol, amount, item)), "
+        "first_accounts AS ("
+        "  SELECT DISTINCT ON (account_id) item, account_id, amount FROM items WHERE kind = 0 ORDER BY account_id, item), "
+        "created AS ("
+        "  INSERT INTO Accounts (account_id, balance) SELECT account_id, amount FROM first_accounts "
+        "  ON CONFLICT (account_id) DO NOTHING RETURNING account_id), "
+        "results AS ("
+        "  SELECT i.item, i.kind, i.account_id, i.symbol, i.amount, CASE "
+        "    WHEN i.kind = 0 AND (f.item <> i.item OR c.account_id IS NULL) THEN 'Account already exists.' "
+        "    WHEN i.kind = 1 AND NOT EXISTS (SELECT 1 FROM Accounts a WHERE a.account_id = i.account_id) "
+        "      AND NOT EXISTS (SELECT 1 FROM first_accounts f2 JOIN created c2 USING (account_id) "
+        "                      WHERE f2.account_id = i.account_id AND f2.item < i.item) THEN 'Account does not exist.' "
+        "  END AS error "
+        "  FROM items i "
+        "  LEFT JOIN first_accounts f ON i.kind = 0 AND f.account_id = i.account_id "
+        "  LEFT JOIN created c ON i.kind = 0 AND c.account_id = i.account_id), "
+        "added AS ("
+        "  INSERT INTO Holdings (account_id, symbol, amount) "
+        "  SELECT account_id, symbol, SUM(amount)::BIGINT FROM results WHERE kind = 1 AND error IS NULL "
+        "  GROUP BY account_id, symbol "
+        "  ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount) "
+        "SELECT item, error FROM results WHERE error IS NOT NULL;");
 }
 
-//ensures order is opened and balance/current holdings are updated atomically using row level lock
-int DatabaseTransactions::place_order(uint32_t account_id, std::string& symbol, int amount, float limit) {
+uint64_t DatabaseTransactions::persisted_seq() {
     pqxx::work W(*thread_conn);
+    pqxx::result res = W.exec_prepared("get_persisted_seq");
+    W.commit();
+    return res.empty() ? 0 : res[0][0].as<uint64_t>();
+}
 
-    pqxx::result res;
-    if (amount >= 0) { //buy; just handle orders of 0 as well
-
-        //make sure balance is enough
-        res = W.exec_params(
-            "SELECT balance FROM Accounts WHERE account_id = $1 FOR UPDATE;", //lock
-            account_id
-        );
-
-        if (res.empty()) {
-            throw CustomException("Account does not exist.");
-        }
-
-        float curr_balance = res[0]["balance"].as<float>();
-
-        if (curr_balance < limit * amount) {
-            throw CustomException("Insufficient balance.");
+//one column of a batch as a postgres array literal: {1,2,3}
+template <typename T>
+static std::string array_literal(const std::vector<T>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i != 0) {
+            out += ",";
         }
+        out += std::to_string(values[i]);
+    }
+    return out + "}";
+}
 
-        
-        W.exec_params(
-            "UPDATE Accounts SET balance = balance - $1 WHERE account_id = $2;",
-            limit * amount, account_id
-        );
-
-    } else { //sell
-        //check if account exists; not going to be updating account table so no lock
-        res = W.exec_params(
-            "SELECT balance FROM Accounts WHERE account_id = $1;",
-            account_id
-        );
-
-        if (res.empty()) {
-            throw CustomException("Account does not exist.");
+//strings are double quoted with \ and " escaped: {"A","B"}
+static std::string array_literal(const std::vector<std::string>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i != 0) {
+            out += ",";
         }
-
-        //make sure current shares is enough to sell
-        res = W.exec_params(
-            "SELECT amount FROM Holdings WHERE account_id = $1 AND symbol = $2 FOR UPDATE;", //lock
-            account_id, symbol
-        );
-
-        if (res.empty()) {
-            throw CustomException("Account does not own shares of this symbol.");
+        out += "\"";
+        for (char c : values[i]) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
         }
+        out += "\"";
+    }
+    return out + "}";
+}
 
-        int curr_amount = res[0]["amount"].as<int>();
-
-        //remember amount is negative since sell
-        if (curr_amount < -1 * amount) {
-            throw CustomException("Insufficient currently owned shares of this symbol.");
+//applies a batch of events in one transaction. Per-row deltas are summed first so every account, holding
+//and order is touched once no matter how many events in the batch involve it; each table then gets one
+//prepared statement with the batch's rows as arrays
+void DatabaseTransactions::persist_events(const std::vector<Event>& events) {
+    struct OrderDelta {
+        int open_shares = 0; //moves towards 0 on fills and cancels
+        int64_t canceled_time = 0;
+    };
+
+    std::vector<int64_t> account_ids, balances;
+    std::map<uint32_t, price_t> balance_deltas;
+    std::map<std::pair<uint32_t, std::string>, int64_t> holding_deltas;
+    std::vector<int> order_ids, order_shares;
+    std::vector<int64_t> order_accounts, order_limits, order_times;
+    std::vector<std::string> order_symbols;
+    std::map<int, OrderDelta> order_deltas;
+    std::vector<int> buy_order_ids, sell_order_ids, trade_shares;
+    std::vector<int64_t> trade_prices, trade_times;
+    std::vector<std::string> trade_symbols;
+
+    for (const Event& event : events) {
+        switch (event.type) {
+        case Event::ACCOUNT_CREATED:
+            account_ids.push_back(event.account_id);
+            balances.push_back(event.price);
+            break;
+
+        case Event::SHARES_ADDED:
+            holding_deltas[std::make_pair(event.account_id, event.symbol)] += event.shares;
+            break;
+
+        case Event::ORDER_ACCEPTED: //reservation of cash (buy) or shares (sell)
+            if (event.shares >= 0) {
+                balance_deltas[event.account_id] -= event.shares * event.price;
+            } else {
+                holding_deltas[std::make_pair(event.account_id, event.symbol)] += event.shares;
+            }
+            order_ids.push_back(event.order_id);
+            order_accounts.push_back(event.account_id);
+            order_symbols.push_back(event.symbol);
+            order_shares.push_back(event.shares);
+            order_limits.push_back(event.price);
+            order_times.push_back(event.time);
+            break;
+
+        case Event::FILL:
+            holding_deltas[std::make_pair(event.account_id, event.symbol)] += event.shares;
+            balance_deltas[event.other_account_id] += event.shares * event.price;
+            order_deltas[event.order_id].open_shares -= event.shares;
+            order_deltas[event.other_order_id].open_shares += event.shares;
+            buy_order_ids.push_back(event.order_id);
+            sell_order_ids.push_back(event.other_order_id);
+            trade_symbols.push_back(event.symbol);
+            trade_shares.push_back(event.shares);
+            trade_prices.push_back(event.price);
+            trade_times.push_back(event.time); //trades are stamped with match time rather than flush time
+            break;
+
+        case Event::ORDER_CANCELED: //refund of what was still open
+            if (event.shares > 0) {
+                balance_deltas[event.account_id] += event.shares * event.price;
+            } else {
+                holding_deltas[std::make_pair(event.account_id, event.symbol)] -= event.shares;
+            }
+            order_deltas[event.order_id].open_shares -= event.shares;
+            order_deltas[event.order_id].canceled_time = event.time;
+            break;
         }
+    }
 
-        
-        W.exec_params(
-            "UPDATE Holdings SET amount = amount + $1 WHERE account_id = $2 AND symbol = $3;",
-            amount, account_id, symbol
-        );
+    pqxx::work W(*thread_conn);
 
+    if (!account_ids.empty()) {
+        W.exec_prepared("insert_accounts", array_literal(account_ids), array_literal(balances));
     }
 
-    //create new order
-    res = W.exec_params("INSERT INTO Orders (account_id, symbol, original_shares, open_shares, limit_price) "
-        "VALUES ($1, $2, $3, $4, $5) RETURNING order_id;",
-        account_id, symbol, amount, amount, limit);
-    int order_id = res[0][0].as<int>(); //store newly created order id so we can return it
-
-    W.commit();
-    pqxx::work W2(*thread_conn); //new transaction
-
-    //do matching; order by order_id to create consistent order of row level locks in FOR UPDATE to prevent deadlock
-    res = W2.exec_params(
-        "SELECT * FROM Orders "
-        "WHERE symbol = $1 AND open_shares != 0 "
-        "ORDER BY order_id ASC FOR UPDATE;",  //Consistent order by order_id
-        symbol);
-
-    //buy and sell lists
-    std::vector<pqxx::row> buy_orders, sell_orders;
-    for (const auto& row : res) {
-        int open_shares = row["open_shares"].as<int>();
-
-        if (open_shares > 0) {
-            buy_orders.push_back(row);
-        } else {
-            sell_orders.push_back(row);
+    if (!balance_deltas.empty()) {
+        std::vector<int64_t> ids, deltas;
+        for (const auto& delta : balance_deltas) {
+            ids.push_back(delta.first);
+            deltas.push_back(delta.second);
         }
+        W.exec_prepared("update_balances", array_literal(ids), array_literal(deltas));
     }
 
-    //sort buy orders: highest limit price first, break ties with earliest timestamp
-    std::sort(buy_orders.begin(), buy_orders.end(), [](const pqxx::row& a, const pqxx::row& b) {
-        double priceA = a["limit_price"].as<double>();
-        double priceB = b["limit_price"].as<double>();
-        return (priceA > priceB) || (priceA == priceB && a["timestamp"].as<std::string>() < b["timestamp"].as<std::string>());
-    });
+    //a batch never takes a holding below zero (the engine journals share credits before debits can use them),
+    //so positive deltas may create rows and negative ones always find an existing row
+    std::vector<int64_t> add_ids, add_amounts, remove_ids, remove_amounts;
+    std::vector<std::string> add_symbols, remove_symbols;
+    for (const auto& delta : holding_deltas) {
+        bool add = delta.second >= 0;
+        (add ? add_ids : remove_ids).push_back(delta.first.first);
+        (add ? add_symbols : remove_symbols).push_back(delta.first.second);
+        (add ? add_amounts : remove_amounts).push_back(delta.second);
+    }
+    if (!add_ids.empty()) {
+        W.exec_prepared("add_holdings", array_literal(add_ids), array_literal(add_symbols), array_literal(add_amounts));
+    }
+    if (!remove_ids.empty()) {
+        W.exec_prepared("remove_holdings", array_literal(remove_ids), array_literal(remove_symbols), array_literal(remove_amounts));
+    }
 
-    //sort sell orders: lowest limit price first, break ties with earliest timestamp
-    std::sort(sell_orders.begin(), sell_orders.end(), [](const pqxx::row& a, const pqxx::row& b) {
-        double priceA = a["limit_price"].as<double>();
-        double priceB = b["limit_price"].as<double>();
-        return (priceA < priceB) || (priceA == priceB && a["timestamp"].as<std::string>() < b["timestamp"].as<std::string>());
-    });
+    if (!order_ids.empty()) {
+        W.exec_prepared("insert_orders", array_literal(order_ids), array_literal(order_accounts), array_literal(order_symbols),
+                        array_literal(order_shares), array_literal(order_limits), array_literal(order_times));
+    }
 
-    // std::cout << "buy list: " << std::endl;
-    // for (auto& buy : buy_orders) {
-    //     int buy_id = buy["order_id"].as<int>();
-    //     int buyer_account = buy["account_id"].as<int>();
-    //     int buy_shares = buy["open_shares"].as<int>();
-    //     double buy_price = buy["limit_price"].as<double>();
-    //     std::string buy_time = buy["timestamp"].as<std::string>();
-
-    //     std::cout << buy_id << " account: " << buyer_account << " shares: " << buy_shares << " price: " << buy_price << " time: " << buy_time << std::endl;
-        
-    // }
-
-    // std::cout << "sell list: " << std::endl;
-    // for (auto& buy : sell_orders) {
-    //     int buy_id = buy["order_id"].as<int>();
-    //     int buyer_account = buy["account_id"].as<int>();
-    //     int buy_shares = buy["open_shares"].as<int>();
-    //     double buy_price = buy["limit_price"].as<double>();
-    //     std::string buy_time = buy["timestamp"].as<std::string>();
-
-    //     std::cout << buy_id << " account: " << buyer_account << " shares: " << buy_shares << " price: " << buy_price << " time: " << buy_time << std::endl;
-        
-    // }
-
-    int buy_index = 0, sell_index = 0;
-    bool buyMoved = true, sellMoved = true;
-    pqxx::row& buy = buy_orders[buy_index];
-    pqxx::row& sell = sell_orders[sell_index];
-    int buy_id, buyer_account, buy_shares, sell_id, seller_account, sell_shares;
-    double buy_price, sell_price;
-    std::string buy_time, sell_time;
-
-    while (buy_index < buy_orders.size() && sell_index < sell_orders.size()) {
-        if (buyMoved) {
-            buy = buy_orders[buy_index];
-            buy_id = buy["order_id"].as<int>();
-            buyer_account = buy["account_id"].as<int>();
-            buy_shares = buy["open_shares"].as<int>();
-            buy_price = buy["limit_price"].as<double>();
-            buy_time = buy["timestamp"].as<std::string>();
+    if (!order_deltas.empty()) {
+        std::vector<int> ids, deltas;
+        std::vector<int64_t> canceled;
+        for (const auto& delta : order_deltas) {
+            ids.push_back(delta.first);
+            deltas.push_back(delta.second.open_shares);
+            canceled.push_back(delta.second.canceled_time);
         }
+        W.exec_prepared("update_orders", array_literal(ids), array_literal(deltas), array_literal(canceled));
+    }
 
-        if (sellMoved) {
-            sell = sell_orders[sell_index];
-            sell_id = sell["order_id"].as<int>();
-            seller_account = sell["account_id"].as<int>();
-            sell_shares = -sell["open_shares"].as<int>();
-            sell_price = sell["limit_price"].as<double>();
-            sell_time = sell["timestamp"].as<std::string>();
-        }
+    if (!buy_order_ids.empty()) {
+        W.exec_prepared("insert_trades", array_literal(buy_order_ids), array_literal(sell_order_ids), array_literal(trade_symbols),
+                        array_literal(trade_shares), array_literal(trade_prices), array_literal(trade_times));
+    }
 
-        if (buy_price < sell_price) {
-            break; //no more possible matches
-        }
+    W.exec_prepared("set_persisted_seq", events.back().seq);
+    W.commit();
+}
 
-        double exec_price = (buy_time < sell_time) ? buy_price : sell_price;
-
-        int trade_shares = std::min(buy_shares, sell_shares);
-
-        //update buyer; no concurrency issues as if any other transaction holds the lock this will pause on update
-        W2.exec_params(
-            "INSERT INTO Holdings (account_id, symbol, amount) VALUES ($1, $2, $3) "
-            "ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;",
-            buyer_account, symbol, trade_shares
-        );
-
-        //update seller; no concurrency issues as if any other transaction holds the lock this will pause
-        W2.exec_params(
-            "UPDATE Accounts SET balance = balance + $1 WHERE account_id = $2;",
-            trade_shares * exec_price, seller_account
-        );
-
-        //update orders
-        W2.exec_params("UPDATE Orders SET open_shares = open_shares - $1 WHERE order_id = $2;", trade_shares, buy_id);
-        W2.exec_params("UPDATE Orders SET open_shares = open_shares + $1 WHERE order_id = $2;", trade_shares, sell_id);
-        buy_shares -= trade_shares;
-        sell_shares -= trade_shares;
-
-        //insert trade
-        W2.exec_params(
-            "INSERT INTO Trades (buy_order_id, sell_order_id, symbol, traded_shares, price) "
-            "VALUES ($1, $2, $3, $4, $5);",
-            buy_id, sell_id, symbol, trade_shares, exec_price
-        );
-
-        //move pointer
-        if (buy_shares == 0)  {
-            buy_index++;
-            buyMoved = true;
-        } else {
-            buyMoved = false;
+//transaction of the document being run by this thread, between begin_batch and end_batch
+static thread_local std::unique_ptr<pqxx::work> document_work;
+static thread_local bool document_deadlocked = false;
+static thread_local uint64_t document_fills = 0; //for Metrics once the document committed
+
+//runs one DATABASE backend call in its own transaction, or in the next GroupCommit batch. Calls lock rows of
+//several accounts in data dependent order, so postgres may pick one as a deadlock victim; the call is
+//atomic, so it is just run again. Group commit batches can still deadlock with document transactions, so
+//their calls are retried the same way.
+//statement, type and symbol say what the call is for DatabaseTelemetry
+template <typename Call>
+static auto with_retry(const char* statement, LatencyStats::RequestType type, const std::string& symbol, Call call)
+    -> decltype(call(std::declval<pqxx::transaction_base&>())) {
+    auto timed_call = [&](pqxx::transaction_base& T) {
+        DatabaseTelemetry::Statement timer(statement, type, symbol, T.conn().backendpid());
+        return call(T);
+    };
+
+    if (document_work) { //a savepoint of the document's transaction, an error only undoes this call
+        try {
+            pqxx::subtransaction S(*document_work);
+            auto result = timed_call(S);
+            S.commit();
+            return result;
+        } catch (const pqxx::deadlock_detected& e) {
+            DatabaseTelemetry::retried(DatabaseTelemetry::DEADLOCK);
+            document_deadlocked = true; //retrying alone would keep the locks of the calls before, redo it all
+            throw;
         }
+    }
 
-        if (sell_shares == 0) { 
-            sell_index++;
-            sellMoved = true;
-        } else {
-            sellMoved = false;
+    //a group commit victim was rolled back to its savepoint, or with its whole batch, so it is queued again
+    for (int attempt = 1; ; attempt++) {
+        try {
+            if (GroupCommit::enabled()) {
+                decltype(call(std::declval<pqxx::transaction_base&>())) result;
+                GroupCommit::run([&](pqxx::transaction_base& T) { result = timed_call(T); });
+                return result;
+            }
+
+            pqxx::work W(*thread_conn);
+            auto result = timed_call(W);
+            LatencyStats::Clock::time_point commit_start = LatencyStats::Clock::now();
+            W.commit();
+            DatabaseTelemetry::committed(type, commit_start);
+            return result;
+        } catch (const pqxx::deadlock_detected& e) {
+            DatabaseTelemetry::retried(DatabaseTelemetry::DEADLOCK);
+            if (attempt == DEADLOCK_ATTEMPTS) {
+                throw;
+            }
+        } catch (const pqxx::serialization_failure& e) {
+            DatabaseTelemetry::retried(DatabaseTelemetry::SERIALIZATION);
+            if (attempt == DEADLOCK_ATTEMPTS) {
+                throw;
+            }
         }
     }
-
-    W2.commit(); //lock released on all rows, another thread trying to run matching can continue
-
-    return order_id;
 }
 
-std::vector<pqxx::result> DatabaseTransactions::query_order(uint32_t account_id, int order_id) {
-    pqxx::work W(*thread_conn);
-
-    //check if account exists; not going to be updating account table so no lock
-    pqxx::result orderRes = W.exec_params(
-        "SELECT balance FROM Accounts WHERE account_id = $1;",
-        account_id
-    );
-
-    if (orderRes.empty()) {
-        throw CustomException("Account does not exist.");
+void DatabaseTransactions::create_account(uint32_t account_id, price_t balance) {
+    if (balance < 0) {
+        throw CustomException("Balance cannot be negative.");
     }
 
-    //check if order exists and belongs to the account, lock order row
-    orderRes = W.exec_params(
-        "SELECT original_shares, open_shares, limit_price, timestamp FROM Orders "
-        "WHERE order_id = $1 AND account_id = $2 FOR UPDATE;",
-        order_id, account_id
-    );
-
-    if (orderRes.empty()) {
-        throw CustomException("Transaction with given id does not exist.");
+    try {
+        with_retry("create_account", LatencyStats::CREATE, "", [&](pqxx::transaction_base& W) { return W.exec_prepared("create_account", account_id, balance); });
+    } catch (const pqxx::unique_violation& e) {
+        throw CustomException("Account already exists.");
     }
-
-    std::vector<pqxx::result> res;
-    res.push_back(orderRes);
-
-    //since order row locked, no new executed trades can be inserted for it, no locking needed
-    orderRes = W.exec_params(
-        "SELECT trade_id, traded_shares, price, timestamp "
-        "FROM Trades WHERE buy_order_id = $1 OR sell_order_id = $1",
-        order_id
-    );
-    res.push_back(orderRes);
-
-    W.commit();
-
-    return res;
-
 }
 
-std::vector<pqxx::result> DatabaseTransactions::cancel_order(uint32_t account_id,int order_id) {
-    pqxx::work W(*thread_conn);
-
-    //check if account exists; not going to be updating account table so no lock
-    pqxx::result orderRes = W.exec_params(
-        "SELECT balance FROM Accounts WHERE account_id = $1;",
-        account_id
-    );
+void DatabaseTransactions::insert_shares(uint32_t account_id, const std::string& symbol, int64_t shares) {
+    if (shares < 0) {
+        throw CustomException("Number of shares cannot be negative.");
+    }
 
-    if (orderRes.empty()) {
+    try {
+        with_retry("insert_shares", LatencyStats::CREATE, symbol, [&](pqxx::transaction_base& W) { return W.exec_prepared("insert_shares", account_id, symbol, shares); });
+    } catch (const pqxx::foreign_key_violation& e) {
         throw CustomException("Account does not exist.");
     }
+}
 
-    //lock order row
-    orderRes = W.exec_params(
-        "SELECT * FROM Orders "
-        "WHERE order_id = $1 AND account_id = $2 FOR UPDATE",
-        order_id, account_id
-    );
+int DatabaseTransactions::place_order(uint32_t account_id, const std::string& symbol, int amount, price_t limit,
+                                      std::vector<Execution>& fills) {
+    pqxx::result res = with_retry("match_order", LatencyStats::ORDER, symbol, [&](pqxx::transaction_base& W) {
+        return W.exec_prepared("match_order", account_id, symbol, amount, limit);
+    });
 
-    if (orderRes.empty()) {
-        throw CustomException("Transaction with given id does not exist.");
+    if (!res[0]["error"].is_null()) {
+        throw CustomException(res[0]["error"].as<std::string>());
     }
 
-    std::vector<pqxx::result> res;
+    int64_t now = Event::now();
+    for (size_t i = 1; i < res.size(); i++) {
+        fills.push_back(Execution{res[i]["shares"].as<int>(), res[i]["price"].as<price_t>(), now});
+    }
+    if (document_work) {
+        document_fills += res.size() - 1;
+    } else {
+        Metrics::fills(res.size() - 1);
+    }
+    return res[0]["order_id"].as<int>();
+}
 
-    int openShares = orderRes[0]["open_shares"].as<int>();
-    float limitPrice = orderRes[0]["limit_price"].as<float>();
-    std::string symbol = orderRes[0]["symbol"].as<std::string>();
+//status rows of engine_order_status/engine_cancel_order as an OrderStatus
+static OrderStatus to_status(int order_id, const pqxx::result& res) {
+    if (!res[0]["error"].is_null()) {
+        throw CustomException(res[0]["error"].as<std::string>());
+    }
 
-    if (openShares == 0) {
-        throw CustomException("Transaction already fully executed or canceled.");
+    OrderStatus status;
+    status.order_id = order_id;
+    status.open_shares = res[0]["open_shares"].as<int>();
+    status.canceled_shares = res[0]["canceled_shares"].as<int>();
+    status.canceled_time = res[0]["canceled_time"].as<int64_t>();
+    for (size_t i = 1; i < res.size(); i++) {
+        status.executions.push_back(Execution{res[i]["exec_shares"].as<int>(), res[i]["exec_price"].as<price_t>(),
+                                              res[i]["exec_time"].as<int64_t>()});
     }
+    return status;
+}
 
-    if (openShares > 0) { //buy
-        //refund balance, will wait for lock
-        W.exec_params(
-            "UPDATE Accounts SET balance = balance + $1 WHERE account_id = $2;",
-            openShares * limitPrice, account_id
-        );
+OrderStatus DatabaseTransactions::query_order(uint32_t account_id, int order_id) {
+    return to_status(order_id, with_retry("order_status", LatencyStats::QUERY, "", [&](pqxx::transaction_base& W) {
+        return W.exec_prepared("order_status", account_id, order_id);
+    }));
+}
 
+OrderStatus DatabaseTransactions::cancel_order(uint32_t account_id, int order_id) {
+    return to_status(order_id, with_retry("cancel_order", LatencyStats::CANCEL, "", [&](pqxx::transaction_base& W) {
+        return W.exec_prepared("cancel_order", account_id, order_id);
+    }));
+}
 
-    } else { //sell
-        //refund shares, will wait for lock
-        W.exec_params(
-            "INSERT INTO Holdings (account_id, symbol, amount) VALUES ($1, $2, $3) "
-            "ON CONFLICT (account_id, symbol) DO UPDATE SET amount = Holdings.amount + EXCLUDED.amount;",
-            account_id, symbol, openShares * -1
-        );
+price_t DatabaseTransactions::balance(uint32_t account_id) {
+    pqxx::result res = with_retry("account_balance", LatencyStats::ORDER, "", [&](pqxx::transaction_base& W) { return W.exec_prepared("account_balance", account_id); });
+    return res.empty() ? 0 : res[0][0].as<price_t>();
+}
 
+bool DatabaseTransactions::create_batch(std::vector<CreateItem>& items) {
+    std::vector<int> kinds;
+    std::vector<int64_t> account_ids, amounts;
+    std::vector<std::string> symbols;
+    std::vector<size_t> positions; //in items, of each item sent
+    for (size_t i = 0; i < items.size(); i++) {
+        if (items[i].error.empty()) {
+            kinds.push_back(items[i].account ? 0 : 1);
+            account_ids.push_back(items[i].account_id);
+            symbols.push_back(items[i].symbol);
+            amounts.push_back(items[i].amount);
+            positions.push_back(i);
+        }
+    }
+    if (positions.empty()) {
+        return true;
     }
 
-    //since order row locked, no new executed trades can be inserted for it, no locking needed
-    orderRes = W.exec_params(
-        "SELECT trade_id, traded_shares, price, timestamp "
-        "FROM Trades WHERE buy_order_id = $1 OR sell_order_id = $1;",
-        order_id
-    );
-
-
-    //update order to reflect as cancelled, update timestamp
-    W.exec_params(
-        "UPDATE Orders SET open_shares = 0, timestamp = now() WHERE order_id = $1;",
-        order_id
-    );
-
-    pqxx::result orderRes2 = W.exec_params(
-        "SELECT original_shares, open_shares, limit_price, timestamp FROM Orders "
-        "WHERE order_id = $1;",
-        order_id
-    );
+    try {
+        pqxx::result res = with_retry("create_batch", LatencyStats::CREATE, "", [&](pqxx::transaction_base& W) {
+            return W.exec_prepared("create_batch", array_literal(kinds), array_literal(account_ids),
+                                   array_literal(symbols), array_literal(amounts));
+        });
+        for (const pqxx::row& row : res) {
+            items[positions[row["item"].as<size_t>() - 1]].error = row["error"].as<std::string>();
+        }
+        return true;
 
-    res.push_back(orderRes2);
-    res.push_back(orderRes);
+    } catch (const std::exception& e) {
+        std::cout << "create batch failed: " << e.what() << std::endl;
+        return false;
+    }
+}
 
-    W.commit();
+bool DatabaseTransactions::begin_batch() {
+    try {
+        document_work.reset(new pqxx::work(*thread_conn));
+        document_deadlocked = false;
+        document_fills = 0;
+        return true;
+    } catch (const std::exception& e) {
+        std::cout << "cannot begin document transaction: " << e.what() << std::endl;
+        return false;
+    }
+}
 
-    return res;
+bool DatabaseTransactions::end_batch() {
+    std::unique_ptr<pqxx::work> W(std::move(document_work));
+    if (!W || document_deadlocked) {
+        return false; //rolled back when W goes
+    }
+    try {
+        LatencyStats::Clock::time_point commit_start = LatencyStats::Clock::now();
+        W->commit();
+        DatabaseTelemetry::committed(LatencyStats::TRANSACTIONS, commit_start);
+        Metrics::fills(document_fills);
+        return true;
+    } catch (const std::exception& e) {
+        std::cout << "document transaction failed: " << e.what() << std::endl;
+        return false;
+    }
 }
@@ -1,23 +1,46 @@
 #ifndef DATABASETRANSACTIONS_H
 #define DATABASETRANSACTIONS_H
 #include <string>
+#include <vector>
 #include <pqxx/pqxx>
+#include "Journal.h"
+#include "OrderStore.h"
 
 class DatabaseTransactions {
 public:
     typedef std::shared_ptr<pqxx::connection> db_ptr;
-    static void setup();
+    static void setup(bool reset);
 
-    static int create_account(uint32_t account_id, float start_balance);
+    //prepares the statements used below on a new connection
+    static void prepare(pqxx::connection& conn);
 
-    static int insert_shares(uint32_t account_id, std::string& symbol, int amount);
+    static uint64_t persisted_seq();
 
-    static int place_order(uint32_t account_id, std::string& symbol, int amount, float limit);
+    static void persist_events(const std::vector<Event>& events);
 
-    static std::vector<pqxx::result> query_order(uint32_t account_id, int order_id);
+    //DATABASE backend (Config::backend): postgres is the source of truth and every request is one call of a
+    //function installed by setup(). Rejections are thrown as CustomException like MatchingEngine's
+    static void create_account(uint32_t account_id, price_t balance);
 
-    static std::vector<pqxx::result> cancel_order(uint32_t account_id,int order_id);
+    static void insert_shares(uint32_t account_id, const std::string& symbol, int64_t shares);
+
+    static int place_order(uint32_t account_id, const std::string& symbol, int amount, price_t limit,
+                           std::vector<Execution>& fills);
+
+    static OrderStatus query_order(uint32_t account_id, int order_id);
+
+    static OrderStatus cancel_order(uint32_t account_id, int order_id);
+
+    //current balance, 0 for an unknown account
+    static price_t balance(uint32_t account_id);
+
+    //whole documents, see MatchingEngine::create_batch. create_batch applies the items without an error in
+    //one statement. begin_batch opens a transaction of this thread that the calls above run in, each in its
+    //own savepoint, until end_batch commits it. false: the batch failed and was rolled back
+    static bool create_batch(std::vector<CreateItem>& items);
+    static bool begin_batch();
+    static bool end_batch();
 
 };
 
-#endif
\ No newline at end of file
+#endif
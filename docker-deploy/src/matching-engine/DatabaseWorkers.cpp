@@ -0,0 +1,78 @@
+#include "DatabaseWorkers.h"
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+
+extern thread_local std::shared_ptr<pqxx::connection> thread_conn; //make thread local db connection visible
+
+boost::asio::io_context DatabaseWorkers::io_context;
+boost::asio::executor_work_guard<boost::asio::io_context::executor_type> DatabaseWorkers::work = boost::asio::make_work_guard(DatabaseWorkers::io_context);
+std::vector<std::thread> DatabaseWorkers::threads;
+std::atomic<int64_t> DatabaseWorkers::queued(0);
+std::atomic<int64_t> DatabaseWorkers::busy(0);
+static std::atomic<int> worker_count(0); //threads is only touched by the main thread
+
+void DatabaseWorkers::start(int count, const std::vector<db_ptr>& connections) {
+    for (int i = 0; i < count; i++) {
+        db_ptr conn = i < int(connections.size()) ? connections[i] : nullptr;
+        threads.emplace_back([conn]{
+            thread_conn = conn;
+            //tasks catch their own exceptions (a failed request is answered with an error), so just keep running
+            io_context.run();
+        });
+    }
+    worker_count = count;
+    std::cout << "started " << count << " database workers" << std::endl;
+}
+
+int DatabaseWorkers::size() {
+    return worker_count;
+}
+
+void DatabaseWorkers::stop() {
+    work.reset(); //lets run() return once the queued tasks are done
+    for (std::thread& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads.clear();
+}
+
+void DatabaseWorkers::run_all(const std::vector<std::function<void()>>& tasks) {
+    struct Progress {
+        std::unique_ptr<std::atomic<bool>[]> claimed; //taken by whoever runs the task, worker or caller
+        std::mutex mutex;
+        std::condition_variable done_changed;
+        size_t done = 0;
+    };
+    auto progress = std::make_shared<Progress>();
+    progress->claimed.reset(new std::atomic<bool>[tasks.size()]);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        progress->claimed[i] = false;
+    }
+
+    //tasks is only touched by a claimer, and the caller doesn't return before every claimed task is done
+    auto run = [&tasks](Progress& state, size_t i) {
+        if (state.claimed[i].exchange(true)) {
+            return;
+        }
+        tasks[i]();
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.done++;
+        }
+        state.done_changed.notify_one();
+    };
+
+    for (size_t i = 1; i < tasks.size(); i++) {
+        post([progress, run, i]() { run(*progress, i); });
+    }
+    for (size_t i = 0; i < tasks.size(); i++) {
+        run(*progress, i);
+    }
+
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->done_changed.wait(lock, [&]() { return progress->done == tasks.size(); });
+}
@@ -0,0 +1,52 @@
+#ifndef DATABASEWORKERS_H
+#define DATABASEWORKERS_H
+
+#include <atomic>
+#include <utility> //before asio: boost 1.74's awaitable.hpp uses std::exchange without including it
+#include <boost/asio.hpp>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <pqxx/pqxx>
+
+//threads that do the work which waits, so io threads never do: the requests of both backends (on postgres,
+//or on the matching shards) and the JOURNALED/PERSISTED durability waits. Sized independently of the io
+//threads (Config::db_workers); with the DATABASE backend every worker owns one connection as its thread_conn. Tasks post their results back to
+//the connection's strand themselves
+class DatabaseWorkers {
+public:
+    typedef std::shared_ptr<pqxx::connection> db_ptr;
+
+    //connections is empty or has one connection per worker
+    static void start(int count, const std::vector<db_ptr>& connections);
+    static void stop();
+
+    template <typename Task>
+    static void post(Task&& task) {
+        queued.fetch_add(1, std::memory_order_relaxed);
+        boost::asio::post(io_context, [task = std::forward<Task>(task)]() mutable {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            busy.fetch_add(1, std::memory_order_relaxed);
+            task();
+            busy.fetch_sub(1, std::memory_order_relaxed);
+        });
+    }
+
+    //runs the tasks side by side on the workers and returns once all are done. The caller runs every task no
+    //worker has started by the time it gets to it, so a worker waiting here never waits on work queued
+    //behind itself. Tasks must not throw
+    static void run_all(const std::vector<std::function<void()>>& tasks);
+
+    //for Metrics: tasks posted but not started, tasks running, workers
+    static std::atomic<int64_t> queued;
+    static std::atomic<int64_t> busy;
+    static int size();
+
+private:
+    static boost::asio::io_context io_context;
+    static boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+    static std::vector<std::thread> threads;
+};
+
+#endif
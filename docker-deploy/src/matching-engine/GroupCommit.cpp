@@ -0,0 +1,108 @@
+#include "GroupCommit.h"
+#include <chrono>
+#include <iostream>
+#include "Config.h"
+#include "DatabaseTelemetry.h"
+#include "LatencyStats.h"
+
+extern thread_local std::shared_ptr<pqxx::connection> thread_conn; //make thread local db connection visible
+
+std::mutex GroupCommit::mutex;
+std::condition_variable GroupCommit::queued;
+std::condition_variable GroupCommit::committed;
+std::vector<GroupCommit::Pending*> GroupCommit::queue;
+bool GroupCommit::running = false;
+std::thread GroupCommit::thread;
+
+void GroupCommit::start(db_ptr conn) {
+    running = true;
+    thread = std::thread(&GroupCommit::loop, conn);
+    std::cout << "group commit every " << Config::group_commit_us << "us or " << Config::group_commit_size << " calls" << std::endl;
+}
+
+void GroupCommit::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    queued.notify_one();
+    if (thread.joinable()) {
+        thread.join(); //committer applies whatever is left first
+    }
+}
+
+bool GroupCommit::enabled() {
+    return Config::backend == Config::DATABASE && Config::group_commit_us > 0;
+}
+
+void GroupCommit::run(const Operation& operation) {
+    Pending pending{&operation, nullptr, false};
+
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.push_back(&pending);
+    if (queue.size() == 1 || queue.size() >= Config::group_commit_size) {
+        queued.notify_one(); //opens the batch window, or closes it early
+    }
+    committed.wait(lock, [&pending]() { return pending.done; });
+
+    if (pending.error) {
+        std::rethrow_exception(pending.error);
+    }
+}
+
+void GroupCommit::loop(db_ptr conn) {
+    thread_conn = conn;
+    std::vector<Pending*> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, []() { return !queue.empty() || !running; });
+            if (queue.empty()) {
+                return; //stopped and drained
+            }
+
+            //the first call opens the window; more join until it closes or the batch is full
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(Config::group_commit_us);
+            queued.wait_until(lock, deadline, []() { return queue.size() >= Config::group_commit_size || !running; });
+            batch.swap(queue);
+        }
+
+        apply(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Pending* pending : batch) {
+                pending->done = true;
+            }
+        }
+        committed.notify_all();
+        batch.clear();
+    }
+}
+
+void GroupCommit::apply(std::vector<Pending*>& batch) {
+    try {
+        pqxx::work W(*thread_conn);
+        for (Pending* pending : batch) {
+            try {
+                pqxx::subtransaction S(W);
+                (*pending->operation)(S);
+                S.commit();
+            } catch (const std::exception& e) {
+                pending->error = std::current_exception(); //rolled back to its savepoint, the rest goes on
+            }
+        }
+        LatencyStats::Clock::time_point commit_start = LatencyStats::Clock::now();
+        W.commit();
+        DatabaseTelemetry::committed(LatencyStats::ANY, commit_start);
+
+    } catch (const std::exception& e) {
+        std::cout << "group commit of " << batch.size() << " calls failed: " << e.what() << std::endl;
+        for (Pending* pending : batch) {
+            if (!pending->error) {
+                pending->error = std::current_exception();
+            }
+        }
+    }
+}
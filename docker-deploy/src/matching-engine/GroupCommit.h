@@ -0,0 +1,51 @@
+#ifndef GROUPCOMMIT_H
+#define GROUPCOMMIT_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pqxx/pqxx>
+
+//DATABASE backend: runs the calls of many concurrent requests in one postgres transaction, so a batch pays
+//one commit (WAL flush) instead of one per request. A batch is closed after Config::group_commit_us or
+//once Config::group_commit_size calls are waiting, applied on the committer's own connection, and every
+//caller is released after the commit. Each call runs in a savepoint, so a call that fails (e.g. a unique
+//violation) only undoes itself. The MEMORY backend already gets this from PersistenceWriter and the journal
+class GroupCommit {
+public:
+    typedef std::shared_ptr<pqxx::connection> db_ptr;
+    typedef std::function<void(pqxx::transaction_base&)> Operation;
+
+    static void start(db_ptr conn);
+    static void stop();
+
+    //started by main when this is true
+    static bool enabled();
+
+    //runs operation in the next batch and blocks until the batch committed. Rethrows what the operation
+    //threw, or the batch's commit failure
+    static void run(const Operation& operation);
+
+private:
+    struct Pending {
+        const Operation* operation;
+        std::exception_ptr error;
+        bool done;
+    };
+
+    static std::mutex mutex;
+    static std::condition_variable queued; //committer waits on this for calls
+    static std::condition_variable committed; //callers wait on this for their batch
+    static std::vector<Pending*> queue;
+    static bool running;
+    static std::thread thread;
+
+    static void loop(db_ptr conn);
+    static void apply(std::vector<Pending*>& batch);
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "Journal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+#include "Binary.h"
+#include "Config.h"
+#include "PersistenceWriter.h"
+
+#define RECORD_HEADER 8 //u32 length + u32 crc
+#define EVENT_FIXED_SIZE 50 //body size without the symbol bytes, see encode()
+#define READ_CHUNK (1 << 20)
+
+std::mutex Journal::mutex;
+std::condition_variable Journal::appended;
+std::condition_variable Journal::synced;
+std::string Journal::buffer;
+size_t Journal::buffered_records = 0;
+uint64_t Journal::appended_seq = 0;
+uint64_t Journal::durable_seq = 0;
+uint64_t Journal::appended_offset = 0;
+thread_local uint64_t Journal::thread_last_seq = 0;
+int Journal::fd = -1;
+bool Journal::running = false;
+std::thread Journal::thread;
+
+int64_t Event::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//body: type u8, seq u64, time i64, account u32, other account u32, order i32, other order i32,
+//shares i64, price i64, symbol length u8, symbol bytes
+void Journal::encode(const Event& event, std::string& out) {
+    size_t start = out.size();
+    out.append(RECORD_HEADER, '\0'); //patched below once the body is written
+
+    put<uint8_t>(out, event.type);
+    put<uint64_t>(out, event.seq);
+    put<int64_t>(out, event.time);
+    put<uint32_t>(out, event.account_id);
+    put<uint32_t>(out, event.other_account_id);
+    put<int32_t>(out, event.order_id);
+    put<int32_t>(out, event.other_order_id);
+    put<int64_t>(out, event.shares);
+    put<int64_t>(out, event.price);
+    put_string(out, event.symbol); //symbols are validated to be short before they get here
+
+    uint32_t length = out.size() - start - RECORD_HEADER;
+    uint32_t crc = crc32(&out[start + RECORD_HEADER], length);
+    std::memcpy(&out[start], &length, sizeof(length));
+    std::memcpy(&out[start + sizeof(length)], &crc, sizeof(crc));
+}
+
+bool Journal::decode(const char* body, size_t length, Event& event) {
+    if (length < EVENT_FIXED_SIZE) {
+        return false;
+    }
+
+    BinaryReader in(body, length);
+    event.type = Event::Type(in.get<uint8_t>());
+    event.seq = in.get<uint64_t>();
+    event.time = in.get<int64_t>();
+    event.account_id = in.get<uint32_t>();
+    event.other_account_id = in.get<uint32_t>();
+    event.order_id = in.get<int32_t>();
+    event.other_order_id = in.get<int32_t>();
+    event.shares = in.get<int64_t>();
+    event.price = in.get<int64_t>();
+
+    size_t symbol_length = (unsigned char)body[EVENT_FIXED_SIZE - 1]; //last fixed byte, see encode()
+
+    if (EVENT_FIXED_SIZE + symbol_length != length || event.type < Event::ACCOUNT_CREATED || event.type > Event::ORDER_CANCELED) {
+        return false;
+    }
+    event.symbol = in.get_string();
+    return true;
+}
+
+bool Journal::enabled() {
+    return fd >= 0;
+}
+
+void Journal::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open journal " + path + ": " + std::strerror(errno));
+    }
+    std::cout << "journal: " << path << std::endl;
+}
+
+void Journal::replay(uint64_t from_seq, uint64_t from_offset, const std::function<void(const Event&)>& apply) {
+    std::string data; //unparsed bytes
+    off_t offset = from_offset; //file offset of data[0]
+    size_t parsed = 0;
+    uint64_t records = 0;
+    bool corrupt = false;
+    std::vector<char> chunk(READ_CHUNK);
+
+    if (lseek(fd, 0, SEEK_END) < offset) {
+        throw std::runtime_error("journal is shorter than the snapshot it should continue, refusing to start");
+    }
+    appended_seq = durable_seq = from_seq;
+    lseek(fd, offset, SEEK_SET); //writes still go to the end because of O_APPEND
+    while (!corrupt) {
+        ssize_t bytes = ::read(fd, chunk.data(), chunk.size());
+        if (bytes < 0) {
+            throw std::runtime_error(std::string("journal read failed: ") + std::strerror(errno));
+        }
+        if (bytes == 0) {
+            break;
+        }
+        data.append(chunk.data(), bytes);
+
+        while (data.size() - parsed >= RECORD_HEADER) {
+            uint32_t length, crc;
+            std::memcpy(&length, &data[parsed], sizeof(length));
+            std::memcpy(&crc, &data[parsed + sizeof(length)], sizeof(crc));
+            if (data.size() - parsed - RECORD_HEADER < length) {
+                break; //rest of the record is in the next chunk (or was never written)
+            }
+
+            Event event;
+            const char* body = &data[parsed + RECORD_HEADER];
+            if (crc32(body, length) != crc || !decode(body, length, event) || event.seq != appended_seq + 1) {
+                corrupt = true;
+                break;
+            }
+
+            apply(event);
+            appended_seq = durable_seq = event.seq;
+            parsed += RECORD_HEADER + length;
+            records++;
+        }
+
+        offset += parsed;
+        data.erase(0, parsed);
+        parsed = 0;
+    }
+
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (offset < end) {
+        std::cout << "journal: cutting " << (end - offset) << " bytes of torn/corrupt tail at offset " << offset << std::endl;
+        if (ftruncate(fd, offset) != 0) {
+            throw std::runtime_error(std::string("journal truncate failed: ") + std::strerror(errno));
+        }
+    }
+    appended_offset = offset;
+    std::cout << "journal: replayed " << records << " events, last seq " << appended_seq << std::endl;
+}
+
+void Journal::start() {
+    if (fd < 0) {
+        return;
+    }
+    running = true;
+    thread = std::thread(&Journal::run);
+}
+
+void Journal::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    appended.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Journal::append(Event& event) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        event.seq = ++appended_seq;
+        thread_last_seq = event.seq;
+        if (fd >= 0) {
+            size_t before = buffer.size();
+            encode(event, buffer);
+            appended_offset += buffer.size() - before;
+            buffered_records++;
+        }
+        PersistenceWriter::enqueue(event); //under our lock so postgres sees the same order as the file
+
+        wake = buffered_records == 1 || buffered_records >= Config::journal_group_records;
+    }
+    if (wake) {
+        appended.notify_one();
+    }
+}
+
+void Journal::sync(uint64_t seq) {
+    if (Config::durability == Config::JOURNALED) {
+        wait_durable(seq);
+    } else if (Config::durability == Config::PERSISTED) {
+        PersistenceWriter::sync(seq);
+    }
+}
+
+uint64_t Journal::thread_seq() {
+    return thread_last_seq;
+}
+
+void Journal::adopt(uint64_t seq) {
+    thread_last_seq = std::max(thread_last_seq, seq);
+}
+
+void Journal::wait_durable(uint64_t seq) {
+    if (fd < 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    synced.wait(lock, [seq]() { return durable_seq >= seq; });
+}
+
+uint64_t Journal::last_seq() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended_seq;
+}
+
+void Journal::position(uint64_t& seq, uint64_t& offset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    seq = appended_seq;
+    offset = appended_offset;
+}
+
+//flush thread: group commit of everything appended while the previous write/fdatasync was in progress,
+//optionally waiting a short window for more appenders to join
+void Journal::run() {
+    std::string out;
+
+    while (true) {
+        uint64_t target;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            appended.wait(lock, []() { return buffered_records > 0 || !running; });
+            if (buffered_records == 0) {
+                return; //stopped and drained
+            }
+
+            if (Config::journal_fsync && Config::journal_group_us > 0 && running) {
+                appended.wait_for(lock, std::chrono::microseconds(Config::journal_group_us),
+                    []() { return buffered_records >= Config::journal_group_records || !running; });
+            }
+
+            out.swap(buffer);
+            buffered_records = 0;
+            target = appended_seq;
+        }
+
+        //a failed write leaves waiters blocked (nothing is acked that isn't on disk) and is retried
+        size_t written = 0;
+        while (written < out.size()) {
+            ssize_t bytes = ::write(fd, out.data() + written, out.size() - written);
+            if (bytes < 0) {
+                if (errno != EINTR) {
+                    std::cout << "journal write failed: " << std::strerror(errno) << ", retrying" << std::endl;
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                }
+                continue;
+            }
+            written += bytes;
+        }
+        while (Config::journal_fsync && fdatasync(fd) != 0) {
+            std::cout << "journal fdatasync failed: " << std::strerror(errno) << ", retrying" << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        out.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            durable_seq = target;
+        }
+        synced.notify_all();
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Price.h"
+
+//an accepted state change. Rejected requests produce no event, so replaying events in order rebuilds
+//accounts, holdings and orders exactly. Field meaning depends on type:
+struct Event {
+    enum Type : uint8_t {
+        ACCOUNT_CREATED = 1, //account_id, price = starting balance
+        SHARES_ADDED = 2, //account_id, symbol, shares
+        ORDER_ACCEPTED = 3, //account_id, order_id, symbol, shares = signed amount, price = limit
+        FILL = 4, //account_id/order_id = buyer, other_account_id/other_order_id = seller, symbol, shares, price
+        ORDER_CANCELED = 5 //account_id, order_id, symbol, shares = signed open shares canceled, price = limit
+    };
+
+    Type type;
+    uint64_t seq = 0; //assigned by Journal::append
+    int64_t time = 0; //microseconds since epoch
+    uint32_t account_id = 0;
+    uint32_t other_account_id = 0;
+    int order_id = 0;
+    int other_order_id = 0;
+    int64_t shares = 0;
+    price_t price = 0;
+    std::string symbol;
+
+    static int64_t now();
+};
+
+//sequenced, append-only binary log of every Event. append() is the single point where events get their
+//global order: the same order goes to the journal file and to the postgres write-behind (PersistenceWriter).
+//A flush thread writes the file in groups and fdatasyncs once per group (Config::journal_fsync_*).
+//
+//file format: records of [u32 body length][u32 crc32 of body][body], little endian, see encode()
+class Journal {
+public:
+    static bool enabled(); //a journal path is configured
+
+    static void open(const std::string& path);
+
+    //reads every intact record after from_seq, starting at byte from_offset (0, 0 for the whole file, or
+    //where a snapshot left off); a torn or corrupt tail (crash mid-write) is cut off
+    static void replay(uint64_t from_seq, uint64_t from_offset, const std::function<void(const Event&)>& apply);
+
+    static void start(); //starts the flush thread
+    static void stop(); //flushes what is left
+
+    //assigns the event's seq and queues it for the file and for postgres
+    static void append(Event& event);
+
+    //blocks until every event up to seq is as durable as Config::durability asks for
+    static void sync(uint64_t seq);
+
+    //last seq appended on this thread, or taken over with adopt() from a shard it waited on: what the
+    //requests this thread ran have to sync, without waiting for other clients' later events
+    static uint64_t thread_seq();
+    static void adopt(uint64_t seq);
+
+    //blocks until seq is on disk; returns at once if there is no journal
+    static void wait_durable(uint64_t seq);
+
+    static uint64_t last_seq();
+
+    //last seq appended and the file offset the next record will be written at
+    static void position(uint64_t& seq, uint64_t& offset);
+
+private:
+    static std::mutex mutex;
+    static std::condition_variable appended; //flush thread waits on this
+    static std::condition_variable synced; //sync() waits on this
+    static std::string buffer; //encoded records not yet written
+    static size_t buffered_records;
+    static uint64_t appended_seq;
+    static uint64_t durable_seq;
+    static uint64_t appended_offset; //file size once everything buffered is written
+    static thread_local uint64_t thread_last_seq;
+    static int fd;
+    static bool running;
+    static std::thread thread;
+
+    static void run();
+    static void encode(const Event& event, std::string& out);
+    static bool decode(const char* body, size_t length, Event& event);
+};
+
+#endif
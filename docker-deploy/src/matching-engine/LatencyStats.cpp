@@ -0,0 +1,128 @@
+#include "LatencyStats.h"
+#include <algorithm>
+#include <cstdio>
+
+std::atomic<LatencyStats::ThreadHistograms*> LatencyStats::threads[MAX_LATENCY_THREADS + 1];
+std::atomic<int> LatencyStats::thread_count(0);
+
+static const char* STAGE_NAMES[] = {"parse", "execute", "statement", "commit", "match", "serialize", "write"};
+static const char* TYPE_NAMES[] = {"create", "transactions", "order", "query", "cancel", "binary", "any"};
+
+//allocated on a thread's first record and kept for good, so summaries() can read it after the thread is gone
+LatencyStats::ThreadHistograms& LatencyStats::thread_histograms() {
+    static thread_local ThreadHistograms* mine = nullptr;
+    if (mine == nullptr) {
+        int slot = std::min(thread_count.fetch_add(1), MAX_LATENCY_THREADS);
+        ThreadHistograms* histograms = threads[slot].load();
+        if (histograms == nullptr) {
+            ThreadHistograms* created = new ThreadHistograms();
+            if (threads[slot].compare_exchange_strong(histograms, created)) {
+                histograms = created;
+            } else {
+                delete created; //another thread took the shared overflow slot first
+            }
+        }
+        mine = histograms;
+    }
+    return *mine;
+}
+
+int LatencyStats::bucket_of(uint64_t nanos) {
+    if (nanos < LATENCY_SUB_BUCKETS) {
+        return int(nanos);
+    }
+    int magnitude = 63 - __builtin_clzll(nanos); //>= 4
+    if (magnitude >= LATENCY_MAX_MAGNITUDE) {
+        return LATENCY_BUCKETS - 1;
+    }
+    int sub = int(nanos >> (magnitude - 4)) - LATENCY_SUB_BUCKETS;
+    return LATENCY_SUB_BUCKETS + (magnitude - 4) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyStats::bucket_limit(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int magnitude = (bucket - LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS + 4;
+    uint64_t sub = (bucket - LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+    uint64_t width = uint64_t(1) << (magnitude - 4);
+    return (LATENCY_SUB_BUCKETS + sub) * width + width - 1;
+}
+
+//single writer per histogram (but for the overflow slot), so relaxed load + store instead of read-modify-write
+void LatencyStats::record(Stage stage, RequestType type, Clock::duration elapsed) {
+    uint64_t nanos = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    Histogram& histogram = thread_histograms().histograms[stage][type];
+
+    std::atomic<uint64_t>& bucket = histogram.counts[bucket_of(nanos)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    histogram.sum.store(histogram.sum.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+    if (nanos > histogram.max.load(std::memory_order_relaxed)) {
+        histogram.max.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+std::vector<LatencyStats::Summary> LatencyStats::summaries() {
+    std::vector<Summary> out;
+    int registered = std::min(thread_count.load(), MAX_LATENCY_THREADS + 1);
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        for (int type = 0; type < TYPE_COUNT; type++) {
+            Summary summary{Stage(stage), RequestType(type), 0, 0, 0, 0, 0, 0, std::vector<uint64_t>(LATENCY_BUCKETS)};
+            for (int i = 0; i < registered; i++) {
+                ThreadHistograms* thread = threads[i].load();
+                if (thread == nullptr) {
+                    continue; //registered but not allocated yet
+                }
+                const Histogram& histogram = thread->histograms[stage][type];
+                for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+                    summary.counts[bucket] += histogram.counts[bucket].load(std::memory_order_relaxed);
+                }
+                summary.sum += histogram.sum.load(std::memory_order_relaxed);
+                summary.max = std::max(summary.max, histogram.max.load(std::memory_order_relaxed));
+            }
+
+            for (uint64_t count : summary.counts) {
+                summary.count += count;
+            }
+            if (summary.count == 0) {
+                continue;
+            }
+
+            uint64_t* percentiles[] = {&summary.p50, &summary.p99, &summary.p999};
+            double fractions[] = {0.5, 0.99, 0.999};
+            for (int p = 0; p < 3; p++) {
+                uint64_t rank = std::max<uint64_t>(1, uint64_t(fractions[p] * summary.count + 0.999999));
+                uint64_t seen = 0;
+                int bucket = 0;
+                while (bucket < LATENCY_BUCKETS - 1 && seen + summary.counts[bucket] < rank) {
+                    seen += summary.counts[bucket++];
+                }
+                //the last bucket is open ended
+                *percentiles[p] = bucket == LATENCY_BUCKETS - 1 ? summary.max : std::min(bucket_limit(bucket), summary.max);
+            }
+            out.push_back(std::move(summary));
+        }
+    }
+    return out;
+}
+
+const char* LatencyStats::stage_name(Stage stage) {
+    return STAGE_NAMES[stage];
+}
+
+const char* LatencyStats::type_name(RequestType type) {
+    return TYPE_NAMES[type];
+}
+
+std::string LatencyStats::report() {
+    std::string out = "latency in us:\nstage         type             count        p50        p99      p99.9        max\n";
+    char line[160];
+    for (const Summary& summary : summaries()) {
+        snprintf(line, sizeof(line), "%-13s %-12s %9llu %10.1f %10.1f %10.1f %10.1f\n",
+                 stage_name(summary.stage), type_name(summary.type), (unsigned long long)summary.count,
+                 summary.p50 / 1000.0, summary.p99 / 1000.0, summary.p999 / 1000.0, summary.max / 1000.0);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,89 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define LATENCY_SUB_BUCKETS 16 //per power of two, so a bucket is at most 1/16 (6%) wide
+#define LATENCY_MAX_MAGNITUDE 40 //2^40 ns, about 18 minutes; anything longer is counted in the last bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_MAGNITUDE - 3) * LATENCY_SUB_BUCKETS) //0-15 exact, then 16 per power of two
+#define MAX_LATENCY_THREADS 256 //threads with histograms of their own, any more share one
+
+//HDR style latency histograms (log-linear buckets of nanoseconds) of every request stage, by request type.
+//Each thread records into histograms of its own with plain relaxed stores, so recording never contends;
+//readers merge the threads' histograms, which are never freed
+class LatencyStats {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Stage {
+        PARSE, //frame fully received until it has been checked by the parser
+        EXECUTE, //one engine call (DatabaseTransactions or the matcher), from the request's thread
+        STATEMENT, //one DATABASE backend statement, from sending it to its result (DatabaseTelemetry)
+        COMMIT, //commit of a DATABASE backend transaction; ANY for group commits
+        MATCH, //the match loop of one order on its shard
+        SERIALIZE, //the executing parse pass minus its engine calls: mostly writing the response
+        WRITE, //response queued until the write that sent it completed
+        STAGE_COUNT
+    };
+
+    enum RequestType {
+        CREATE, //<create> document or account/shares action
+        TRANSACTIONS, //<transactions> document
+        ORDER,
+        QUERY,
+        CANCEL,
+        BINARY, //binary protocol message
+        ANY, //not attributable to one type, e.g. a write carries many responses
+        TYPE_COUNT
+    };
+
+    struct Summary {
+        Stage stage;
+        RequestType type;
+        uint64_t count;
+        uint64_t sum; //ns
+        uint64_t p50, p99, p999, max; //ns, percentiles to bucket precision
+        std::vector<uint64_t> counts; //per bucket, see bucket_limit
+    };
+
+    static void record(Stage stage, RequestType type, Clock::duration elapsed);
+
+    static void record_since(Stage stage, RequestType type, Clock::time_point start) {
+        record(stage, type, Clock::now() - start);
+    }
+
+    //merged over every thread; only the histograms anything was recorded in
+    static std::vector<Summary> summaries();
+
+    //largest value (ns) counted in bucket
+    static uint64_t bucket_limit(int bucket);
+
+    static const char* stage_name(Stage stage);
+    static const char* type_name(RequestType type);
+
+    //table of count/p50/p99/p99.9/max in microseconds, for the SIGUSR1 dump
+    static std::string report();
+
+private:
+    struct Histogram {
+        std::atomic<uint64_t> counts[LATENCY_BUCKETS];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    struct ThreadHistograms {
+        Histogram histograms[STAGE_COUNT][TYPE_COUNT];
+    };
+
+    static std::atomic<ThreadHistograms*> threads[]; //registered threads, see thread_histograms
+    static std::atomic<int> thread_count;
+
+    static ThreadHistograms& thread_histograms();
+    static int bucket_of(uint64_t nanos);
+};
+
+#endif
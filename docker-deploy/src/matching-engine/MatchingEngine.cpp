@@ -0,0 +1,561 @@
+#include "MatchingEngine.h"
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include "AccountStore.h"
+#include "CustomException.h"
+#include "Journal.h"
+#include "LatencyStats.h"
+#include "Metrics.h"
+#include "Config.h"
+#include "DatabaseTransactions.h"
+#include "DatabaseWorkers.h"
+#include "OrderBook.h"
+#include "PersistenceWriter.h"
+#include "Snapshot.h"
+
+std::vector<std::unique_ptr<MatchingShard>> MatchingEngine::shards;
+
+//state of one symbol, only ever touched by the shard thread that owns the symbol
+struct SymbolState {
+    OrderBook book;
+    std::unordered_map<uint32_t, int64_t> holdings; //shares of this symbol by account
+};
+
+thread_local std::unordered_map<std::string, SymbolState> shard_symbols; //symbols owned by this thread's shard
+
+MatchingShard::MatchingShard() : work(boost::asio::make_work_guard(io_context)) {
+    thread = std::thread([this]{
+        symbols = &shard_symbols;
+        //a failing task only fails its own request (exception goes to the waiting future), so just keep running
+        io_context.run();
+    });
+}
+
+MatchingShard::~MatchingShard() {
+    stop();
+}
+
+void MatchingShard::stop() {
+    work.reset(); //let run() return once queued tasks are done
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void MatchingEngine::start(int shard_count) {
+    for (int i = 0; i < shard_count; i++) {
+        shards.emplace_back(new MatchingShard());
+    }
+    std::cout << "started " << shards.size() << " matching shards" << std::endl;
+}
+
+void MatchingEngine::stop() {
+    shards.clear();
+}
+
+MatchingShard& MatchingEngine::shard_for(const std::string& symbol) {
+    return *shards[std::hash<std::string>()(symbol) % shards.size()];
+}
+
+static void check_symbol(const std::string& symbol) {
+    if (symbol.empty() || symbol.size() > MAX_SYMBOL_LENGTH) {
+        throw CustomException("Invalid symbol.");
+    }
+}
+
+static OrderRecord record_for(const Event& accepted) {
+    return OrderRecord{accepted.account_id, accepted.symbol, int(accepted.shares), int(accepted.shares), accepted.price,
+                       accepted.time, 0, 0, std::vector<Execution>()};
+}
+
+//effects of a fill on holdings, balances and order records (the book is updated by the caller)
+static void apply_fill(SymbolState& state, const Event& fill) {
+    state.holdings[fill.account_id] += fill.shares;
+    AccountStore::credit(fill.other_account_id, fill.shares * fill.price); //bounded by what the buyer reserved
+
+    Execution execution = {int(fill.shares), fill.price, fill.time};
+    OrderStore::record_execution(fill.order_id, -fill.shares, execution);
+    OrderStore::record_execution(fill.other_order_id, fill.shares, execution);
+}
+
+//refund of the canceled open shares (reserved cash for buys, reserved shares for sells)
+static void apply_cancel(SymbolState& state, const Event& cancel) {
+    if (cancel.shares > 0) {
+        AccountStore::credit(cancel.account_id, cancel.shares * cancel.price); //was reserved, can't overflow
+    } else {
+        state.holdings[cancel.account_id] -= cancel.shares;
+    }
+    OrderStore::record_cancel(cancel.order_id, cancel.time);
+}
+
+//journal replay of one event on the owning shard. Books are rebuilt from the recorded fills rather than by
+//matching again, so replay doesn't depend on the matching code that produced them
+static void replay_event(const Event& event) {
+    SymbolState& state = shard_symbols[event.symbol];
+
+    switch (event.type) {
+    case Event::SHARES_ADDED:
+        state.holdings[event.account_id] += event.shares;
+        break;
+
+    case Event::ORDER_ACCEPTED:
+        if (event.shares >= 0) {
+            AccountStore::credit(event.account_id, -(event.shares * event.price));
+        } else {
+            state.holdings[event.account_id] += event.shares;
+        }
+        OrderStore::insert(event.order_id, record_for(event));
+        state.book.rest_order(event.order_id, event.account_id, event.shares, event.price);
+        break;
+
+    case Event::FILL:
+        apply_fill(state, event);
+        state.book.reduce_order(event.order_id, event.shares);
+        state.book.reduce_order(event.other_order_id, event.shares);
+        break;
+
+    case Event::ORDER_CANCELED:
+        apply_cancel(state, event);
+        state.book.cancel_order(event.order_id);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void MatchingEngine::recover(uint64_t persisted_seq) {
+    uint64_t snapshot_seq = 0, snapshot_offset = 0;
+    if (!Config::snapshot_path.empty() && Snapshot::load(Config::snapshot_path, snapshot_seq, snapshot_offset)) {
+        for (const std::pair<int, OrderRecord>& order : OrderStore::open_orders()) {
+            boost::asio::post(shard_for(order.second.symbol).io_context, [order]() {
+                shard_symbols[order.second.symbol].book.rest_order(
+                    order.first, order.second.account_id, order.second.open_shares, order.second.limit_price);
+            });
+        }
+    }
+
+    //only the tail after the snapshot needs reading, unless postgres is further behind than the snapshot
+    bool tail_only = persisted_seq >= snapshot_seq;
+    Journal::replay(tail_only ? snapshot_seq : 0, tail_only ? snapshot_offset : 0, [snapshot_seq, persisted_seq](const Event& event) {
+        if (event.seq <= snapshot_seq) {
+            //already in the snapshot
+        } else if (event.type == Event::ACCOUNT_CREATED) {
+            AccountStore::restore(event.account_id, event.price); //before any later event can use the account
+        } else {
+            if (event.type == Event::ORDER_ACCEPTED) {
+                OrderStore::restore_next_order_id(event.order_id);
+            }
+            boost::asio::post(shard_for(event.symbol).io_context, [event]() { replay_event(event); });
+        }
+
+        if (event.seq > persisted_seq) {
+            PersistenceWriter::enqueue(event);
+        }
+    });
+
+    if (Journal::last_seq() < snapshot_seq) {
+        throw std::runtime_error("journal ends before the snapshot, refusing to start");
+    }
+
+    //wait for every shard to finish its share of the replay
+    for (std::unique_ptr<MatchingShard>& shard : shards) {
+        auto barrier = std::make_shared<std::promise<void>>();
+        boost::asio::post(shard->io_context, [barrier]() { barrier->set_value(); });
+        barrier->get_future().get();
+    }
+}
+
+void MatchingEngine::quiesce(const std::function<void()>& action) {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    std::vector<std::future<void>> parked;
+    for (std::unique_ptr<MatchingShard>& shard : shards) {
+        auto arrived = std::make_shared<std::promise<void>>();
+        parked.push_back(arrived->get_future());
+        boost::asio::post(shard->io_context, [arrived, released]() {
+            arrived->set_value();
+            released.wait();
+        });
+    }
+    for (std::future<void>& shard : parked) {
+        shard.wait();
+    }
+
+    try {
+        std::unique_lock<std::shared_mutex> accounts = AccountStore::lock_all();
+        action();
+    } catch (...) {
+        release.set_value();
+        throw;
+    }
+    release.set_value();
+}
+
+//symbol count u32, then per symbol: symbol, holder count u32, (account u32, shares i64)*
+void MatchingEngine::save_symbols(std::string& out) {
+    uint32_t count = 0;
+    for (std::unique_ptr<MatchingShard>& shard : shards) {
+        count += shard->symbols->size();
+    }
+
+    put<uint32_t>(out, count);
+    for (std::unique_ptr<MatchingShard>& shard : shards) {
+        for (const auto& symbol : *shard->symbols) {
+            put_string(out, symbol.first);
+            put<uint32_t>(out, symbol.second.holdings.size());
+            for (const auto& holding : symbol.second.holdings) {
+                put<uint32_t>(out, holding.first);
+                put<int64_t>(out, holding.second);
+            }
+        }
+    }
+}
+
+void MatchingEngine::load_symbols(BinaryReader& in) {
+    uint32_t count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < count; i++) {
+        std::string symbol = in.get_string();
+        std::unordered_map<uint32_t, int64_t> holdings;
+        uint32_t holders = in.get<uint32_t>();
+        for (uint32_t k = 0; k < holders; k++) {
+            uint32_t account_id = in.get<uint32_t>();
+            holdings[account_id] = in.get<int64_t>();
+        }
+
+        boost::asio::post(shard_for(symbol).io_context, [symbol, holdings]() {
+            shard_symbols[symbol].holdings = holdings;
+        });
+    }
+}
+
+void MatchingEngine::create_account(uint32_t account_id, price_t balance) {
+    if (Config::backend == Config::DATABASE) {
+        DatabaseTransactions::create_account(account_id, balance);
+        return;
+    }
+    AccountStore::create(account_id, balance);
+}
+
+void MatchingEngine::insert_shares(uint32_t account_id, const std::string& symbol, int64_t shares) {
+    check_symbol(symbol);
+    if (Config::backend == Config::DATABASE) {
+        DatabaseTransactions::insert_shares(account_id, symbol, shares);
+        return;
+    }
+    if (!AccountStore::exists(account_id)) {
+        throw CustomException("Account does not exist.");
+    }
+    if (shares < 0) {
+        throw CustomException("Number of shares cannot be negative.");
+    }
+
+    run_on_shard<void>(symbol, [account_id, &symbol, shares]() {
+        Event event;
+        event.type = Event::SHARES_ADDED;
+        event.time = Event::now();
+        event.account_id = account_id;
+        event.symbol = symbol;
+        event.shares = shares;
+        Journal::append(event);
+
+        shard_symbols[symbol].holdings[account_id] += shares;
+    });
+}
+
+//runs on the symbol's shard: reserve cash or shares, accept, match against the book
+static int execute_order(uint32_t account_id, const std::string& symbol, int amount, price_t limit) {
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    SymbolState& state = shard_symbols[symbol];
+
+    if (amount >= 0) { //buy; just handle orders of 0 as well
+        price_t cost;
+        if (!Price::notional(limit, amount, cost) || !AccountStore::reserve(account_id, cost)) {
+            throw CustomException("Insufficient balance.");
+        }
+    } else { //sell
+        auto holding = state.holdings.find(account_id);
+        if (holding == state.holdings.end()) {
+            throw CustomException("Account does not own shares of this symbol.");
+        }
+
+        //remember amount is negative since sell
+        if (holding->second < -int64_t(amount)) {
+            throw CustomException("Insufficient currently owned shares of this symbol.");
+        }
+        holding->second += amount;
+    }
+
+    Event accepted;
+    accepted.type = Event::ORDER_ACCEPTED;
+    accepted.time = Event::now();
+    accepted.account_id = account_id;
+    accepted.order_id = OrderStore::next_order_id();
+    accepted.symbol = symbol;
+    accepted.shares = amount;
+    accepted.price = limit;
+    Journal::append(accepted); //after the reservation was taken, see AccountStore
+    OrderStore::insert(accepted.order_id, record_for(accepted));
+
+    std::vector<Fill> fills = state.book.add_order(accepted.order_id, account_id, amount, limit);
+    Metrics::fills(fills.size());
+    for (const Fill& fill : fills) {
+        Event event;
+        event.type = Event::FILL;
+        event.time = accepted.time;
+        event.account_id = fill.buyer_account;
+        event.other_account_id = fill.seller_account;
+        event.order_id = fill.buy_order_id;
+        event.other_order_id = fill.sell_order_id;
+        event.symbol = symbol;
+        event.shares = fill.shares;
+        event.price = fill.price;
+        Journal::append(event); //before the seller's credit becomes visible
+        apply_fill(state, event);
+    }
+
+    LatencyStats::record_since(LatencyStats::MATCH, LatencyStats::ORDER, start);
+    return accepted.order_id;
+}
+
+//place_order's checks that don't need any state
+static void check_order(const std::string& symbol, int amount, price_t limit) {
+    check_symbol(symbol);
+    if (amount == std::numeric_limits<int>::min()) {
+        throw CustomException("Invalid amount.");
+    }
+    if (limit <= 0) { //a buy would reserve nothing, or be credited for it
+        throw CustomException("Invalid limit price.");
+    }
+}
+
+//sets the order's error from the exception being handled
+static void reject(OrderItem& order) {
+    try {
+        throw;
+    } catch (const CustomException& e) {
+        order.error = e.what();
+    } catch (const std::exception& e) {
+        std::cout << "unknown exception in place_order: " << e.what() << std::endl;
+        order.error = "Unexpected error.";
+    }
+}
+
+int MatchingEngine::place_order(uint32_t account_id, const std::string& symbol, int amount, price_t limit) {
+    check_order(symbol, amount, limit);
+    if (Config::backend == Config::DATABASE) {
+        std::vector<Execution> fills; //already booked by the stored function
+        return DatabaseTransactions::place_order(account_id, symbol, amount, limit, fills);
+    }
+    if (!AccountStore::exists(account_id)) {
+        throw CustomException("Account does not exist.");
+    }
+
+    return run_on_shard<int>(symbol, [account_id, &symbol, amount, limit]() {
+        return execute_order(account_id, symbol, amount, limit);
+    });
+}
+
+//a wave is the longest run of orders from the first one on where every order has a symbol of its own and
+//the balance before the wave covers all of its buys. Then no order of the wave reads state another one
+//writes: sells only touch their own symbol's holdings, and a buy succeeds whatever the others did before it,
+//as fills and refunds only ever add to the balance
+void MatchingEngine::place_orders(uint32_t account_id, std::vector<OrderItem>& orders) {
+    size_t next = 0;
+    while (next < orders.size()) {
+        std::vector<OrderItem*> wave;
+        std::vector<const std::string*> symbols;
+        price_t buys = 0; //cost of the wave's buys
+        price_t balance = -1; //read once a second order needs it
+
+        for (; next < orders.size(); next++) {
+            OrderItem& order = orders[next];
+            if (!order.error.empty()) {
+                continue;
+            }
+            try {
+                check_order(order.symbol, order.amount, order.limit);
+            } catch (...) {
+                reject(order);
+                continue;
+            }
+
+            bool fits = true;
+            for (const std::string* symbol : symbols) {
+                fits = fits && *symbol != order.symbol;
+            }
+            price_t cost = 0;
+            if (order.amount >= 0 && !Price::notional(order.limit, order.amount, cost)) {
+                fits = false; //rejected, but only after the orders before it
+            } else if (fits && order.amount >= 0 && !wave.empty()) {
+                if (balance < 0) {
+                    balance = Config::backend == Config::DATABASE ? DatabaseTransactions::balance(account_id)
+                                                                  : AccountStore::balance(account_id);
+                }
+                fits = cost <= balance - buys;
+            }
+            if (!fits && !wave.empty()) {
+                break;
+            }
+
+            wave.push_back(&order);
+            symbols.push_back(&order.symbol);
+            buys += cost;
+        }
+
+        if (wave.size() == 1 || !Config::parallel_symbols) {
+            for (OrderItem* order : wave) {
+                try {
+                    order->order_id = place_order(account_id, order->symbol, order->amount, order->limit);
+                } catch (...) {
+                    reject(*order);
+                }
+            }
+
+        } else if (Config::backend == Config::DATABASE) {
+            std::vector<std::function<void()>> tasks;
+            for (OrderItem* order : wave) {
+                tasks.push_back([account_id, order]() {
+                    try {
+                        std::vector<Execution> fills; //already booked by the stored function
+                        order->order_id = DatabaseTransactions::place_order(account_id, order->symbol, order->amount, order->limit, fills);
+                    } catch (...) {
+                        reject(*order);
+                    }
+                });
+            }
+            DatabaseWorkers::run_all(tasks);
+
+        } else if (!AccountStore::exists(account_id)) {
+            for (OrderItem* order : wave) {
+                order->error = "Account does not exist.";
+            }
+
+        } else {
+            std::vector<std::future<int>> placed;
+            for (OrderItem* order : wave) {
+                placed.push_back(post_to_shard<int>(order->symbol, [account_id, order]() {
+                    return execute_order(account_id, order->symbol, order->amount, order->limit);
+                }));
+            }
+            for (size_t i = 0; i < wave.size(); i++) {
+                try {
+                    wave[i]->order_id = wait_on_shard(wave[i]->symbol, placed[i]);
+                } catch (...) {
+                    reject(*wave[i]);
+                }
+            }
+        }
+    }
+}
+
+bool MatchingEngine::create_batch(std::vector<CreateItem>& items) {
+    for (CreateItem& item : items) {
+        if (!item.error.empty()) {
+            continue;
+        }
+        try {
+            if (Config::backend == Config::DATABASE) { //checked here, the rest is done by the one statement
+                if (item.account && item.amount < 0) {
+                    throw CustomException("Balance cannot be negative.");
+                }
+                if (!item.account) {
+                    check_symbol(item.symbol);
+                    if (item.amount < 0) {
+                        throw CustomException("Number of shares cannot be negative.");
+                    }
+                }
+            } else if (item.account) {
+                create_account(item.account_id, item.amount);
+            } else {
+                insert_shares(item.account_id, item.symbol, item.amount);
+            }
+
+        } catch (const CustomException& e) {
+            item.error = e.what();
+        } catch (const std::exception& e) {
+            std::cout << "unknown exception in create_batch: " << e.what() << std::endl;
+            item.error = "Unexpected error.";
+        }
+    }
+
+    if (Config::backend == Config::DATABASE) {
+        return DatabaseTransactions::create_batch(items);
+    }
+    return true;
+}
+
+bool MatchingEngine::begin_batch() {
+    if (Config::backend == Config::DATABASE) {
+        return DatabaseTransactions::begin_batch();
+    }
+    return true;
+}
+
+bool MatchingEngine::end_batch() {
+    if (Config::backend == Config::DATABASE) {
+        return DatabaseTransactions::end_batch();
+    }
+    return true;
+}
+
+OrderStatus MatchingEngine::query_order(uint32_t account_id, int order_id) {
+    if (Config::backend == Config::DATABASE) {
+        return DatabaseTransactions::query_order(account_id, order_id);
+    }
+    if (!AccountStore::exists(account_id)) {
+        throw CustomException("Account does not exist.");
+    }
+    OrderStatus status = OrderStore::status(order_id, account_id);
+    Journal::adopt(Journal::last_seq()); //the fills it reports may come from any shard; nothing newer is synced
+    return status;
+}
+
+//runs on the order's shard: pull it from the book and refund what was still open
+static OrderStatus execute_cancel(uint32_t account_id, int order_id) {
+    OrderRecord record;
+    if (!OrderStore::find(order_id, account_id, record)) {
+        throw CustomException("Transaction with given id does not exist.");
+    }
+    if (record.open_shares == 0) {
+        throw CustomException("Transaction already fully executed or canceled.");
+    }
+
+    SymbolState& state = shard_symbols[record.symbol];
+    state.book.cancel_order(order_id);
+
+    Event canceled;
+    canceled.type = Event::ORDER_CANCELED;
+    canceled.time = Event::now();
+    canceled.account_id = account_id;
+    canceled.order_id = order_id;
+    canceled.symbol = record.symbol;
+    canceled.shares = record.open_shares;
+    canceled.price = record.limit_price;
+    Journal::append(canceled); //before the refund becomes visible
+    apply_cancel(state, canceled);
+
+    return OrderStore::status(order_id, account_id);
+}
+
+OrderStatus MatchingEngine::cancel_order(uint32_t account_id, int order_id) {
+    if (Config::backend == Config::DATABASE) {
+        return DatabaseTransactions::cancel_order(account_id, order_id);
+    }
+    if (!AccountStore::exists(account_id)) {
+        throw CustomException("Account does not exist.");
+    }
+
+    OrderRecord record;
+    if (!OrderStore::find(order_id, account_id, record)) {
+        throw CustomException("Transaction with given id does not exist.");
+    }
+
+    return run_on_shard<OrderStatus>(record.symbol, [account_id, order_id]() {
+        return execute_cancel(account_id, order_id);
+    });
+}
@@ -0,0 +1,127 @@
+#ifndef MATCHINGENGINE_H
+#define MATCHINGENGINE_H
+
+#include <utility> //before asio: boost 1.74's awaitable.hpp uses std::exchange without including it
+#include <boost/asio.hpp>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Binary.h"
+#include "Journal.h"
+#include "OrderStore.h"
+#include "Price.h"
+
+#define MAX_SYMBOL_LENGTH 20
+
+struct SymbolState;
+
+//a matching shard is one thread with its own io_context (inbound queue). Every symbol is owned by exactly
+//one shard, which keeps the symbol's book and holdings, so all work on a symbol is single writer and lock free
+class MatchingShard {
+public:
+    boost::asio::io_context io_context;
+    std::unordered_map<std::string, SymbolState>* symbols = nullptr; //the shard thread's symbols, for snapshots
+    std::atomic<uint64_t> journaled_seq{0}; //last seq the shard thread appended, set before a task completes
+
+    MatchingShard();
+    ~MatchingShard();
+
+    void stop();
+
+private:
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+    std::thread thread;
+};
+
+//the exchange: in-memory accounts (AccountStore), orders (OrderStore) and per-symbol books and holdings
+//(on the shards). Every accepted change is journaled (Journal) and mirrored to postgres (PersistenceWriter).
+//Rejections are thrown as CustomException with the message for the client. With Config::DATABASE the
+//requests are passed straight to DatabaseTransactions instead
+class MatchingEngine {
+public:
+    static void start(int shard_count);
+    static void stop();
+
+    //rebuilds state from the latest snapshot (if any) and the journal after it. Events postgres hasn't seen
+    //yet (seq > persisted_seq) are queued for it again
+    static void recover(uint64_t persisted_seq);
+
+    //runs action with every shard parked between tasks and account creation blocked, so nothing can change
+    //state or append to the journal while it runs
+    static void quiesce(const std::function<void()>& action);
+
+    //snapshot encoding of the per-symbol holdings (books are rebuilt from OrderStore::open_orders)
+    static void save_symbols(std::string& out);
+    static void load_symbols(BinaryReader& in);
+
+    static void create_account(uint32_t account_id, price_t balance);
+
+    static void insert_shares(uint32_t account_id, const std::string& symbol, int64_t shares);
+
+    static int place_order(uint32_t account_id, const std::string& symbol, int amount, price_t limit);
+
+    //consecutive orders of one request, with the outcome place_order would have given each in turn. Orders
+    //for different symbols whose buys the balance covers all together can't change each other's outcome, so
+    //such runs of them are placed side by side: on their shards, or with the DATABASE backend on several
+    //database workers. Sets order_id, or error if rejected
+    static void place_orders(uint32_t account_id, std::vector<OrderItem>& orders);
+
+    static OrderStatus query_order(uint32_t account_id, int order_id);
+
+    static OrderStatus cancel_order(uint32_t account_id, int order_id);
+
+    //whole documents (Config::document_batch). create_batch applies every item of a <create>, setting the
+    //error of each one rejected. Between begin_batch and end_batch the calls of this thread share one
+    //transaction. With the DATABASE backend either returns false if postgres couldn't apply the batch, and
+    //then nothing of it was; the MEMORY backend runs the calls one by one and never fails a batch
+    static bool create_batch(std::vector<CreateItem>& items);
+    static bool begin_batch();
+    static bool end_batch();
+
+private:
+    static std::vector<std::unique_ptr<MatchingShard>> shards;
+
+    static MatchingShard& shard_for(const std::string& symbol);
+
+    //queues task on the symbol's shard; the future has its result or exception. Collect it with
+    //wait_on_shard, so the caller takes over the seqs the task appended
+    template <typename Result, typename Task>
+    static std::future<Result> post_to_shard(const std::string& symbol, Task task) {
+        MatchingShard& shard = shard_for(symbol);
+        auto packaged = std::make_shared<std::packaged_task<Result()>>([task, &shard]() mutable {
+            struct RecordSeq { //also when task throws, before the future is ready
+                MatchingShard& shard;
+                ~RecordSeq() { shard.journaled_seq = Journal::thread_seq(); }
+            } record_seq{shard};
+            return task();
+        });
+        std::future<Result> result = packaged->get_future();
+        //posted through a lambda: asio treats a bare packaged_task as a completion token and takes its future itself
+        boost::asio::post(shard.io_context, [packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    //blocks until the task posted to the symbol's shard is done, rethrowing its exception. Covers
+    //everything the task could have seen on the shard in what this thread has to sync (Journal::thread_seq)
+    template <typename Result>
+    static Result wait_on_shard(const std::string& symbol, std::future<Result>& result) {
+        result.wait();
+        Journal::adopt(shard_for(symbol).journaled_seq);
+        return result.get();
+    }
+
+    //runs task on the symbol's shard and blocks the calling thread (a DatabaseWorkers thread, never an io
+    //thread) until it is done
+    template <typename Result, typename Task>
+    static Result run_on_shard(const std::string& symbol, Task task) {
+        std::future<Result> result = post_to_shard<Result>(symbol, task);
+        return wait_on_shard(symbol, result);
+    }
+};
+
+#endif
@@ -4,7 +4,19 @@
 #include "DatabaseTransactions.h"
 #include <stdexcept>
 
-MatchingEngineServer::MatchingEngineServer(boost::asio::io_context& io_context, int port) : io_context_(io_context), acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port_option;
+
+MatchingEngineServer::MatchingEngineServer(boost::asio::io_context& io_context, int port, TcpConnection::Protocol protocol, bool reuse_port) : io_context_(io_context), acceptor_(io_context), protocol_(protocol) {
+    //what the acceptor's endpoint constructor does, with SO_REUSEPORT set before the bind when asked
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), port);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    if (reuse_port) {
+        acceptor_.set_option(reuse_port_option(true));
+    }
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+
     start_accept(); //only 1 thread calls, start accepting connections
 }
 
@@ -14,7 +26,7 @@ MatchingEngineServer::~MatchingEngineServer() {
 
 //start accepting connections on port
 void MatchingEngineServer::start_accept() {
-    TcpConnection::ptr new_connection = TcpConnection::create(io_context_);
+    TcpConnection::ptr new_connection = TcpConnection::create(io_context_, protocol_);
 
     boost::asio::ip::tcp::socket& sock = new_connection->socket;
     // acceptor_.async_accept(sock, //async task, 1 thread in pool will call completion handler
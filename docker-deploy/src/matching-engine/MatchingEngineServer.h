@@ -1,5 +1,6 @@
 #ifndef MATCHINGENGINESERVER_H
 #define MATCHINGENGINESERVER_H
+#include <utility> //before asio: boost 1.74's awaitable.hpp uses std::exchange without including it
 #include <boost/asio.hpp>
 #include "TcpConnection.h"
 #include <pqxx/pqxx>
@@ -13,10 +14,12 @@ public:
     typedef std::shared_ptr<pqxx::connection> db_ptr;
     boost::asio::io_context& io_context_;
     boost::asio::ip::tcp::acceptor acceptor_;
+    TcpConnection::Protocol protocol_; //spoken by every connection accepted here
     //db_ptr db;
 
 
-    MatchingEngineServer(boost::asio::io_context& io_context, int port);
+    //reuse_port binds with SO_REUSEPORT, so one acceptor per io_context can listen on the same port
+    MatchingEngineServer(boost::asio::io_context& io_context, int port, TcpConnection::Protocol protocol = TcpConnection::XML, bool reuse_port = false);
     ~MatchingEngineServer();
 
 
@@ -0,0 +1,107 @@
+#include "Metrics.h"
+#include <cstdio>
+#include "DatabaseTelemetry.h"
+#include "DatabaseWorkers.h"
+#include "LatencyStats.h"
+
+std::atomic<int64_t> Metrics::open_connections(0);
+std::atomic<int64_t> Metrics::reads_in_progress(0);
+std::atomic<uint64_t> Metrics::requests[REQUEST_COUNT];
+std::atomic<uint64_t> Metrics::fill_count(0);
+std::mutex Metrics::rejects_mutex;
+std::unordered_map<std::string, uint64_t> Metrics::rejects;
+
+static const char* REQUEST_NAMES[] = {"account", "shares", "order", "query", "cancel"};
+
+void Metrics::request(Request type, const std::string& error) {
+    requests[type].fetch_add(1, std::memory_order_relaxed);
+    if (!error.empty()) {
+        std::lock_guard<std::mutex> lock(rejects_mutex);
+        rejects[error]++;
+    }
+}
+
+//label values are client facing messages, escaped as the text format wants
+static std::string label_value(const std::string& value) {
+    std::string out;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static void header(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+static void sample(std::string& out, const std::string& name_and_labels, double value) {
+    char number[32];
+    snprintf(number, sizeof(number), " %.10g\n", value);
+    out += name_and_labels;
+    out += number;
+}
+
+std::string Metrics::render() {
+    std::string out;
+
+    header(out, "engine_requests_total", "counter", "Requests handled, rejected ones included.");
+    for (int type = 0; type < REQUEST_COUNT; type++) {
+        sample(out, std::string("engine_requests_total{type=\"") + REQUEST_NAMES[type] + "\"}", requests[type].load());
+    }
+
+    header(out, "engine_rejects_total", "counter", "Rejected requests by the error returned to the client.");
+    {
+        std::lock_guard<std::mutex> lock(rejects_mutex);
+        for (const auto& reject : rejects) {
+            sample(out, "engine_rejects_total{reason=\"" + label_value(reject.first) + "\"}", reject.second);
+        }
+    }
+
+    header(out, "engine_fills_total", "counter", "Executions, one per matched pair of orders.");
+    sample(out, "engine_fills_total", fill_count.load());
+
+    header(out, "engine_open_connections", "gauge", "Client connections, both protocols.");
+    sample(out, "engine_open_connections", open_connections.load());
+
+    header(out, "engine_reads_in_progress", "gauge", "Reads whose requests are being executed, waiting on the engine or postgres.");
+    sample(out, "engine_reads_in_progress", reads_in_progress.load());
+
+    header(out, "engine_db_worker_queue", "gauge", "Tasks waiting for a database worker.");
+    sample(out, "engine_db_worker_queue", DatabaseWorkers::queued.load());
+
+    header(out, "engine_db_workers_busy", "gauge", "Database workers running a task; with the database backend, connections in use.");
+    sample(out, "engine_db_workers_busy", DatabaseWorkers::busy.load());
+
+    header(out, "engine_db_workers", "gauge", "Database workers (and database backend connections).");
+    sample(out, "engine_db_workers", DatabaseWorkers::size());
+
+    DatabaseTelemetry::render(out);
+
+    header(out, "engine_latency_seconds", "summary", "Latency of each request stage, see LatencyStats.");
+    for (const LatencyStats::Summary& summary : LatencyStats::summaries()) {
+        std::string labels = std::string("stage=\"") + LatencyStats::stage_name(summary.stage) +
+                             "\",type=\"" + LatencyStats::type_name(summary.type) + "\"";
+        sample(out, "engine_latency_seconds{" + labels + ",quantile=\"0.5\"}", summary.p50 / 1e9);
+        sample(out, "engine_latency_seconds{" + labels + ",quantile=\"0.99\"}", summary.p99 / 1e9);
+        sample(out, "engine_latency_seconds{" + labels + ",quantile=\"0.999\"}", summary.p999 / 1e9);
+        sample(out, "engine_latency_seconds{" + labels + ",quantile=\"1\"}", summary.max / 1e9);
+        sample(out, "engine_latency_seconds_sum{" + labels + "}", summary.sum / 1e9);
+        sample(out, "engine_latency_seconds_count{" + labels + "}", summary.count);
+    }
+    return out;
+}
@@ -0,0 +1,37 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//engine counters and gauges, rendered in the Prometheus text format by MetricsServer together with the
+//LatencyStats summaries. Rates (orders per second and so on) are left to Prometheus' rate() over the totals
+class Metrics {
+public:
+    enum Request { ACCOUNT, SHARES, ORDER, QUERY, CANCEL, REQUEST_COUNT };
+
+    //one handled request; error is the message it was rejected with, if it was
+    static void request(Request type, const std::string& error);
+
+    static void fills(uint64_t count) {
+        fill_count.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    static std::atomic<int64_t> open_connections;
+    static std::atomic<int64_t> reads_in_progress; //reads whose requests are being executed
+
+    //the whole exposition, every metric with its HELP and TYPE lines
+    static std::string render();
+
+private:
+    static std::atomic<uint64_t> requests[REQUEST_COUNT];
+    static std::atomic<uint64_t> fill_count;
+
+    static std::mutex rejects_mutex;
+    static std::unordered_map<std::string, uint64_t> rejects; //by message
+};
+
+#endif
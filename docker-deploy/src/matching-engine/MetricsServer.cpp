@@ -0,0 +1,58 @@
+#include "MetricsServer.h"
+#include <iostream>
+#include <string>
+#include "DatabaseTelemetry.h"
+#include "LatencyStats.h"
+#include "Metrics.h"
+
+#define MAX_HTTP_REQUEST 8192 //a scrape is a few hundred bytes of headers
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+MetricsServer::MetricsServer(boost::asio::io_context& io_context, int port)
+    : acceptor(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {
+    boost::asio::co_spawn(io_context, accept(), boost::asio::detached);
+    std::cout << "metrics on port " << port << std::endl;
+}
+
+awaitable<void> MetricsServer::accept() {
+    while (true) {
+        boost::system::error_code error;
+        boost::asio::ip::tcp::socket socket = co_await acceptor.async_accept(boost::asio::redirect_error(use_awaitable, error));
+        if (error == boost::asio::error::operation_aborted) {
+            break;
+        }
+        if (!error) {
+            boost::asio::co_spawn(acceptor.get_executor(), serve(std::move(socket)), boost::asio::detached);
+        }
+    }
+}
+
+awaitable<void> MetricsServer::serve(boost::asio::ip::tcp::socket socket) {
+    try {
+        std::string request;
+        co_await boost::asio::async_read_until(socket, boost::asio::dynamic_buffer(request, MAX_HTTP_REQUEST), "\r\n\r\n", use_awaitable);
+
+        std::string status = "200 OK";
+        std::string body;
+        if (request.compare(0, 13, "GET /metrics ") == 0) {
+            body = Metrics::render();
+        } else if (request.compare(0, 13, "GET /latency ") == 0) {
+            body = LatencyStats::report() + DatabaseTelemetry::report();
+        } else {
+            status = "404 Not Found";
+            body = "GET /metrics or /latency\n";
+        }
+
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+        co_await boost::asio::async_write(socket, boost::asio::buffer(response), use_awaitable);
+
+    } catch (const boost::system::system_error& e) { //client went away or sent too much
+    }
+    boost::system::error_code ignored;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+}
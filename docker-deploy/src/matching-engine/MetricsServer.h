@@ -0,0 +1,21 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <utility> //before asio: boost 1.74's awaitable.hpp uses std::exchange without including it
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+
+//minimal HTTP/1.1 endpoint on its own port, run by an engine io_context: GET /metrics answers the
+//Prometheus text exposition (Metrics), GET /latency the LatencyStats and DatabaseTelemetry tables. One request per connection
+class MetricsServer {
+public:
+    MetricsServer(boost::asio::io_context& io_context, int port);
+
+private:
+    boost::asio::ip::tcp::acceptor acceptor;
+
+    boost::asio::awaitable<void> accept();
+    static boost::asio::awaitable<void> serve(boost::asio::ip::tcp::socket socket);
+};
+
+#endif
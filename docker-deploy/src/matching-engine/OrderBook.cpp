@@ -0,0 +1,124 @@
+#include "OrderBook.h"
+#include <algorithm>
+
+//walks the opposite side from the best price while it crosses the incoming limit, consuming resting orders in FIFO order
+template <typename Levels, typename Crosses>
+void OrderBook::match(Levels& levels, Crosses crosses, bool incoming_is_buy, int order_id, uint32_t account_id,
+                      int& remaining, price_t limit, std::vector<Fill>& fills) {
+    while (remaining > 0 && !levels.empty()) {
+        auto level = levels.begin();
+        if (!crosses(level->first, limit)) {
+            break; //no more possible matches
+        }
+
+        PriceLevel& queue = level->second;
+        while (remaining > 0 && !queue.empty()) {
+            RestingOrder& resting = queue.front();
+            int trade_shares = std::min(remaining, resting.open_shares);
+
+            Fill fill;
+            fill.shares = trade_shares;
+            fill.price = resting.limit_price; //resting order is always the older one
+            if (incoming_is_buy) {
+                fill.buy_order_id = order_id;
+                fill.buyer_account = account_id;
+                fill.sell_order_id = resting.order_id;
+                fill.seller_account = resting.account_id;
+            } else {
+                fill.buy_order_id = resting.order_id;
+                fill.buyer_account = resting.account_id;
+                fill.sell_order_id = order_id;
+                fill.seller_account = account_id;
+            }
+            fills.push_back(fill);
+
+            remaining -= trade_shares;
+            resting.open_shares -= trade_shares;
+            if (resting.open_shares == 0) {
+                orders.erase(resting.order_id);
+                queue.pop_front();
+            }
+        }
+
+        if (queue.empty()) {
+            levels.erase(level);
+        }
+    }
+}
+
+std::vector<Fill> OrderBook::add_order(int order_id, uint32_t account_id, int amount, price_t limit) {
+    std::vector<Fill> fills;
+    bool is_buy = amount >= 0;
+    int remaining = is_buy ? amount : -amount;
+
+    if (is_buy) {
+        match(asks, [](price_t ask, price_t bid) { return ask <= bid; }, true, order_id, account_id, remaining, limit, fills);
+    } else {
+        match(bids, [](price_t bid, price_t ask) { return bid >= ask; }, false, order_id, account_id, remaining, limit, fills);
+    }
+
+    if (remaining > 0) {
+        rest_order(order_id, account_id, is_buy ? remaining : -remaining, limit);
+    }
+
+    return fills;
+}
+
+//puts an order at the back of its price level
+void OrderBook::rest_order(int order_id, uint32_t account_id, int amount, price_t limit) {
+    if (amount == 0) {
+        return;
+    }
+
+    Location location;
+    location.is_buy = amount > 0;
+    RestingOrder resting = {order_id, account_id, location.is_buy ? amount : -amount, limit};
+    if (location.is_buy) {
+        location.bid_level = bids.emplace(limit, PriceLevel()).first;
+        location.order = location.bid_level->second.insert(location.bid_level->second.end(), resting);
+    } else {
+        location.ask_level = asks.emplace(limit, PriceLevel()).first;
+        location.order = location.ask_level->second.insert(location.ask_level->second.end(), resting);
+    }
+    orders[order_id] = location;
+}
+
+void OrderBook::reduce_order(int order_id, int shares) {
+    auto found = orders.find(order_id);
+    if (found == orders.end()) {
+        return;
+    }
+
+    RestingOrder& resting = *found->second.order;
+    resting.open_shares -= shares;
+    if (resting.open_shares <= 0) {
+        cancel_order(order_id);
+    }
+}
+
+bool OrderBook::cancel_order(int order_id) {
+    auto found = orders.find(order_id);
+    if (found == orders.end()) {
+        return false;
+    }
+
+    Location& location = found->second;
+    if (location.is_buy) {
+        location.bid_level->second.erase(location.order);
+        if (location.bid_level->second.empty()) {
+            bids.erase(location.bid_level);
+        }
+    } else {
+        location.ask_level->second.erase(location.order);
+        if (location.ask_level->second.empty()) {
+            asks.erase(location.ask_level);
+        }
+    }
+
+    orders.erase(found);
+    return true;
+}
+
+bool OrderBook::empty() const {
+    return orders.empty();
+}
@@ -0,0 +1,71 @@
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Price.h"
+
+//an order resting in the book; open_shares is always positive, the side is given by which book it rests in
+struct RestingOrder {
+    int order_id;
+    uint32_t account_id;
+    int open_shares;
+    price_t limit_price;
+};
+
+//one execution between an incoming order and a resting order
+struct Fill {
+    int buy_order_id;
+    int sell_order_id;
+    uint32_t buyer_account;
+    uint32_t seller_account;
+    int shares;
+    price_t price; //always the resting (older) order's limit price
+};
+
+//resident price-time priority book for a single symbol. Bids and asks are kept as ordered price levels,
+//each level is a FIFO queue of resting orders. Insert/match/cancel cost O(log levels) plus O(1) per fill.
+class OrderBook {
+public:
+    //matches an incoming order (amount > 0 buy, < 0 sell) against the opposite side and rests any remainder.
+    //fills are returned in execution order
+    std::vector<Fill> add_order(int order_id, uint32_t account_id, int amount, price_t limit);
+
+    //removes a resting order, returns false if it is not in the book (fully executed or already canceled)
+    bool cancel_order(int order_id);
+
+    //journal replay: rest an order without matching, then apply its recorded fills with reduce_order.
+    //keeps recovery independent of the matching logic that produced the fills
+    void rest_order(int order_id, uint32_t account_id, int amount, price_t limit);
+    void reduce_order(int order_id, int shares);
+
+    bool empty() const;
+
+private:
+    typedef std::list<RestingOrder> PriceLevel;
+    typedef std::map<price_t, PriceLevel, std::greater<price_t>> BidLevels; //best (highest) bid first
+    typedef std::map<price_t, PriceLevel, std::less<price_t>> AskLevels; //best (lowest) ask first
+
+    //where a resting order lives, so cancel doesn't have to search
+    struct Location {
+        bool is_buy;
+        BidLevels::iterator bid_level;
+        AskLevels::iterator ask_level;
+        PriceLevel::iterator order;
+    };
+
+    BidLevels bids;
+    AskLevels asks;
+    std::unordered_map<int, Location> orders;
+
+    template <typename Levels, typename Crosses>
+    void match(Levels& levels, Crosses crosses, bool incoming_is_buy, int order_id, uint32_t account_id,
+               int& remaining, price_t limit, std::vector<Fill>& fills);
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "OrderStore.h"
+#include <algorithm>
+#include <cstdlib>
+#include "CustomException.h"
+
+OrderStore::Stripe OrderStore::stripes[ORDER_STORE_STRIPES];
+std::atomic<int> OrderStore::next_id(1);
+
+OrderStore::Stripe& OrderStore::stripe_for(int order_id) {
+    return stripes[(unsigned)order_id % ORDER_STORE_STRIPES];
+}
+
+int OrderStore::next_order_id() {
+    return next_id.fetch_add(1);
+}
+
+void OrderStore::restore_next_order_id(int order_id) {
+    int current = next_id.load();
+    while (current <= order_id && !next_id.compare_exchange_weak(current, order_id + 1)) {
+    }
+}
+
+void OrderStore::insert(int order_id, const OrderRecord& record) {
+    Stripe& stripe = stripe_for(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.orders[order_id] = record;
+}
+
+bool OrderStore::find(int order_id, uint32_t account_id, OrderRecord& record) {
+    Stripe& stripe = stripe_for(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto found = stripe.orders.find(order_id);
+    if (found == stripe.orders.end() || found->second.account_id != account_id) {
+        return false;
+    }
+    record = found->second;
+    return true;
+}
+
+OrderStatus OrderStore::status(int order_id, uint32_t account_id) {
+    Stripe& stripe = stripe_for(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto found = stripe.orders.find(order_id);
+    if (found == stripe.orders.end() || found->second.account_id != account_id) {
+        throw CustomException("Transaction with given id does not exist.");
+    }
+
+    const OrderRecord& record = found->second;
+    return OrderStatus{order_id, record.open_shares, record.canceled_shares, record.canceled_time, record.executions};
+}
+
+void OrderStore::record_execution(int order_id, int open_shares_delta, const Execution& execution) {
+    Stripe& stripe = stripe_for(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto found = stripe.orders.find(order_id);
+    if (found != stripe.orders.end()) {
+        found->second.open_shares += open_shares_delta;
+        found->second.executions.push_back(execution);
+    }
+}
+
+void OrderStore::record_cancel(int order_id, int64_t time) {
+    Stripe& stripe = stripe_for(order_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto found = stripe.orders.find(order_id);
+    if (found != stripe.orders.end()) {
+        found->second.canceled_shares = std::abs(found->second.open_shares);
+        found->second.canceled_time = time;
+        found->second.open_shares = 0;
+    }
+}
+
+//next id i32, count u32, then per record: id i32, account u32, symbol, original i32, open i32, limit i64,
+//time i64, canceled shares i32, canceled time i64, execution count u32, (shares i32, price i64, time i64)*
+void OrderStore::save(std::string& out) {
+    size_t count = 0;
+    for (const Stripe& stripe : stripes) {
+        count += stripe.orders.size();
+    }
+
+    put<int32_t>(out, next_id.load());
+    put<uint32_t>(out, count);
+    for (const Stripe& stripe : stripes) {
+        for (const auto& order : stripe.orders) {
+            const OrderRecord& record = order.second;
+            put<int32_t>(out, order.first);
+            put<uint32_t>(out, record.account_id);
+            put_string(out, record.symbol);
+            put<int32_t>(out, record.original_shares);
+            put<int32_t>(out, record.open_shares);
+            put<int64_t>(out, record.limit_price);
+            put<int64_t>(out, record.time);
+            put<int32_t>(out, record.canceled_shares);
+            put<int64_t>(out, record.canceled_time);
+            put<uint32_t>(out, record.executions.size());
+            for (const Execution& execution : record.executions) {
+                put<int32_t>(out, execution.shares);
+                put<int64_t>(out, execution.price);
+                put<int64_t>(out, execution.time);
+            }
+        }
+    }
+}
+
+void OrderStore::load(BinaryReader& in) {
+    int next = in.get<int32_t>();
+    uint32_t count = in.get<uint32_t>();
+
+    for (uint32_t i = 0; i < count; i++) {
+        int order_id = in.get<int32_t>();
+        OrderRecord record;
+        record.account_id = in.get<uint32_t>();
+        record.symbol = in.get_string();
+        record.original_shares = in.get<int32_t>();
+        record.open_shares = in.get<int32_t>();
+        record.limit_price = in.get<int64_t>();
+        record.time = in.get<int64_t>();
+        record.canceled_shares = in.get<int32_t>();
+        record.canceled_time = in.get<int64_t>();
+        uint32_t executions = in.get<uint32_t>();
+        for (uint32_t k = 0; k < executions; k++) {
+            Execution execution;
+            execution.shares = in.get<int32_t>();
+            execution.price = in.get<int64_t>();
+            execution.time = in.get<int64_t>();
+            record.executions.push_back(execution);
+        }
+        insert(order_id, record);
+    }
+    restore_next_order_id(next - 1);
+}
+
+std::vector<std::pair<int, OrderRecord>> OrderStore::open_orders() {
+    std::vector<std::pair<int, OrderRecord>> open;
+    for (Stripe& stripe : stripes) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (const auto& order : stripe.orders) {
+            if (order.second.open_shares != 0) {
+                open.push_back(order);
+            }
+        }
+    }
+
+    std::sort(open.begin(), open.end(), [](const std::pair<int, OrderRecord>& a, const std::pair<int, OrderRecord>& b) {
+        return a.first < b.first;
+    });
+    return open;
+}
@@ -0,0 +1,101 @@
+#ifndef ORDERSTORE_H
+#define ORDERSTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Binary.h"
+#include "Price.h"
+
+#define ORDER_STORE_STRIPES 64
+
+struct Execution {
+    int shares;
+    price_t price;
+    int64_t time; //microseconds since epoch
+};
+
+//everything needed to answer query/cancel for an order
+struct OrderRecord {
+    uint32_t account_id;
+    std::string symbol;
+    int original_shares; //buy = positive, sell = negative
+    int open_shares; //buy = positive, sell = negative
+    price_t limit_price;
+    int64_t time;
+    int canceled_shares; //0 unless canceled
+    int64_t canceled_time;
+    std::vector<Execution> executions;
+};
+
+struct OrderStatus {
+    int order_id;
+    int open_shares;
+    int canceled_shares;
+    int64_t canceled_time;
+    std::vector<Execution> executions;
+};
+
+//one <account> or <symbol> child of a <create>, for MatchingEngine::create_batch
+struct CreateItem {
+    bool account; //else a share insert
+    uint32_t account_id;
+    std::string symbol;
+    int64_t amount; //balance or shares
+    std::string error; //why it was rejected; items that come with one are skipped
+};
+
+//one <order> of a <transactions>, for MatchingEngine::place_orders
+struct OrderItem {
+    std::string symbol;
+    int amount;
+    price_t limit;
+    int order_id; //set once placed
+    std::string error; //why it was rejected; items that come with one are skipped
+};
+
+//every order ever accepted, by id. Records are written by the shard owning the order's symbol and read by
+//any io thread answering a query, so the map is split into stripes with one mutex each
+class OrderStore {
+public:
+    static int next_order_id();
+
+    static void insert(int order_id, const OrderRecord& record);
+
+    //the order's record, if it exists and belongs to the account
+    static bool find(int order_id, uint32_t account_id, OrderRecord& record);
+
+    //throws CustomException if the order doesn't exist or isn't the account's
+    static OrderStatus status(int order_id, uint32_t account_id);
+
+    //fill/cancel bookkeeping, called from the owning shard (and from journal replay)
+    static void record_execution(int order_id, int open_shares_delta, const Execution& execution);
+    static void record_cancel(int order_id, int64_t time);
+
+    //journal replay: ids handed out from now on must be above everything replayed
+    static void restore_next_order_id(int order_id);
+
+    //snapshot encoding of every record and the id counter. save() doesn't lock, it runs in the forked
+    //snapshot child (or with the shards parked)
+    static void save(std::string& out);
+    static void load(BinaryReader& in);
+
+    //orders still open, oldest first (book priority), to put back on the books after a snapshot load
+    static std::vector<std::pair<int, OrderRecord>> open_orders();
+
+private:
+    struct Stripe {
+        std::mutex mutex;
+        std::unordered_map<int, OrderRecord> orders;
+    };
+
+    static Stripe stripes[ORDER_STORE_STRIPES];
+    static std::atomic<int> next_id;
+
+    static Stripe& stripe_for(int order_id);
+};
+
+#endif
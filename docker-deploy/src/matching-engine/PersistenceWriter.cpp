@@ -0,0 +1,103 @@
+#include "PersistenceWriter.h"
+#include <chrono>
+#include <iostream>
+#include "Config.h"
+#include "DatabaseTransactions.h"
+
+extern thread_local std::shared_ptr<pqxx::connection> thread_conn; //make thread local db connection visible
+
+#define FLUSH_ATTEMPTS 3 //of a failing batch once stopping; while running it is retried until it succeeds
+#define MAX_FLUSH_BACKOFF 30 //seconds between retries of a failing batch
+
+std::mutex PersistenceWriter::mutex;
+std::condition_variable PersistenceWriter::queued;
+std::condition_variable PersistenceWriter::flushed;
+std::vector<Event> PersistenceWriter::queue;
+uint64_t PersistenceWriter::flushed_seq = 0;
+bool PersistenceWriter::running = false;
+std::thread PersistenceWriter::thread;
+
+void PersistenceWriter::start(db_ptr conn, uint64_t persisted_seq) {
+    flushed_seq = persisted_seq;
+    running = true;
+    thread = std::thread(&PersistenceWriter::run, conn);
+}
+
+void PersistenceWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    queued.notify_one();
+    if (thread.joinable()) {
+        thread.join(); //writer drains whatever is left first
+    }
+}
+
+void PersistenceWriter::enqueue(const Event& event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(event);
+    }
+    queued.notify_one();
+}
+
+void PersistenceWriter::sync(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushed.wait(lock, [seq]() { return flushed_seq >= seq; });
+}
+
+void PersistenceWriter::run(db_ptr conn) {
+    thread_conn = conn;
+    std::vector<Event> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, []() { return !queue.empty() || !running; });
+            if (queue.empty()) {
+                return; //stopped and drained
+            }
+
+            //take up to one batch, oldest first
+            size_t count = std::min(queue.size(), Config::persist_batch_size);
+            batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + count));
+            queue.erase(queue.begin(), queue.begin() + count);
+        }
+
+        //postgres must never get ahead of the journal, or a crash could leave it with events replay doesn't know
+        Journal::wait_durable(batch.back().seq);
+
+        //a batch is never skipped: flushed_seq, and the persisted_seq postgres stores with each batch, must not
+        //pass events postgres doesn't have, or they would be acked and recovery would never replay them.
+        //A failing flush is retried until it succeeds, holding back everything queued after it
+        std::chrono::seconds backoff(1);
+        for (int attempt = 1; ; attempt++) {
+            try {
+                DatabaseTransactions::persist_events(batch);
+                break;
+            } catch (const std::exception& e) {
+                std::cout << "write-behind flush of " << batch.size() << " events failed (attempt " << attempt
+                          << "): " << e.what() << std::endl;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running && attempt >= FLUSH_ATTEMPTS) {
+                    //shutting down: the journal still has these, they are replayed on the next start
+                    std::cout << "stopping with " << batch.size() + queue.size() << " events not persisted" << std::endl;
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min(backoff * 2, std::chrono::seconds(MAX_FLUSH_BACKOFF));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            flushed_seq = batch.back().seq;
+        }
+        flushed.notify_all();
+        batch.clear();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef PERSISTENCEWRITER_H
+#define PERSISTENCEWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pqxx/pqxx>
+#include "Journal.h"
+
+//write-behind stage that mirrors the engine's events into postgres. Events arrive in journal order
+//(Journal::append calls enqueue); one writer thread drains the queue and applies everything queued so far
+//in a single batched transaction. Postgres is never read on the request path
+class PersistenceWriter {
+public:
+    typedef std::shared_ptr<pqxx::connection> db_ptr;
+
+    //persisted_seq: last event postgres already has, from a previous run
+    static void start(db_ptr conn, uint64_t persisted_seq);
+    static void stop();
+
+    static void enqueue(const Event& event);
+
+    //blocks until every event up to seq has been flushed to postgres
+    static void sync(uint64_t seq);
+
+private:
+    static std::mutex mutex;
+    static std::condition_variable queued; //writer waits on this for work
+    static std::condition_variable flushed; //sync() waits on this
+    static std::vector<Event> queue;
+    static uint64_t flushed_seq; //last event flushed, never past one postgres doesn't have
+    static bool running;
+    static std::thread thread;
+
+    static void run(db_ptr conn);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "Price.h"
+#include <charconv>
+#include <limits>
+
+bool Price::parse(const char* text, price_t& value) {
+    if (text == nullptr) {
+        return false;
+    }
+
+    const char* c = text;
+    bool negative = false;
+    if (*c == '-' || *c == '+') {
+        negative = *c == '-';
+        c++;
+    }
+
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    int64_t ticks = 0;
+    bool has_digits = false;
+    for (; *c >= '0' && *c <= '9'; c++) {
+        if (ticks > (max / SCALE - (*c - '0')) / 10) {
+            return false; //overflow
+        }
+        ticks = ticks * 10 + (*c - '0');
+        has_digits = true;
+    }
+    ticks *= SCALE;
+
+    if (*c == '.') {
+        c++;
+        int64_t place = SCALE / 10;
+        for (; *c >= '0' && *c <= '9'; c++) {
+            if (place == 0) {
+                if (*c != '0') {
+                    return false; //finer than one tick
+                }
+                continue;
+            }
+            ticks += (*c - '0') * place;
+            place /= 10;
+            has_digits = true;
+        }
+    }
+
+    if (!has_digits || *c != '\0') {
+        return false;
+    }
+
+    value = negative ? -ticks : ticks;
+    return true;
+}
+
+std::string Price::format(price_t value) {
+    char text[MAX_FORMAT_LENGTH];
+    return std::string(text, format(value, text));
+}
+
+char* Price::format(price_t value, char* out) {
+    //work on the magnitude as unsigned so INT64_MIN doesn't overflow
+    uint64_t magnitude = value < 0 ? uint64_t(0) - uint64_t(value) : uint64_t(value);
+    uint64_t whole = magnitude / SCALE;
+    uint64_t fraction = magnitude % SCALE;
+
+    if (value < 0) {
+        *out++ = '-';
+    }
+    out = std::to_chars(out, out + MAX_FORMAT_LENGTH - 1, whole).ptr;
+
+    if (fraction != 0) {
+        char digits[DECIMALS];
+        for (int i = DECIMALS - 1; i >= 0; i--) {
+            digits[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        int length = DECIMALS;
+        while (digits[length - 1] == '0') {
+            length--; //trim trailing zeros
+        }
+        *out++ = '.';
+        for (int i = 0; i < length; i++) {
+            *out++ = digits[i];
+        }
+    }
+
+    return out;
+}
+
+bool Price::notional(price_t price, int64_t shares, price_t& value) {
+    return !__builtin_mul_overflow(price, shares, &value);
+}
@@ -0,0 +1,31 @@
+#ifndef PRICE_H
+#define PRICE_H
+
+#include <cstdint>
+#include <string>
+
+//fixed point price/cash amount, in ticks of 1/Price::SCALE. Used for limits, execution prices and balances
+//everywhere (parser, matcher, db columns, responses) so comparisons are integer ops and money never rounds
+typedef int64_t price_t;
+
+class Price {
+public:
+    static const int DECIMALS = 4;
+    static const int64_t SCALE = 10000; //10^DECIMALS ticks per unit
+    static const int MAX_FORMAT_LENGTH = 26; //"-" + 19 digits + "." + DECIMALS digits, plus a spare byte
+
+    //parses a plain decimal string ("100", "-3.5", "0.0001"). Fails on anything that isn't a decimal number,
+    //on digits finer than one tick, and on overflow
+    static bool parse(const char* text, price_t& value);
+
+    //shortest decimal form, e.g. 1000000 -> "100", 12345 -> "1.2345"
+    static std::string format(price_t value);
+
+    //same, written to out (at least MAX_FORMAT_LENGTH bytes, not terminated); returns the end of the text
+    static char* format(price_t value, char* out);
+
+    //price * shares, fails on overflow
+    static bool notional(price_t price, int64_t shares, price_t& value);
+};
+
+#endif
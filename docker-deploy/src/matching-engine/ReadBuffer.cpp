@@ -0,0 +1,52 @@
+#include "ReadBuffer.h"
+#include <cstring>
+
+ReadBuffer::ReadBuffer(size_t initial_capacity) : storage(initial_capacity) {
+
+}
+
+const char* ReadBuffer::data() const {
+    return storage.data() + begin;
+}
+
+size_t ReadBuffer::size() const {
+    return end - begin;
+}
+
+char* ReadBuffer::prepare(size_t min_free) {
+    if (storage.size() - end < min_free) {
+        //slide the unconsumed bytes to the front first, grow only if that isn't enough
+        if (begin > 0) {
+            std::memmove(storage.data(), storage.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        if (storage.size() - end < min_free) {
+            size_t capacity = storage.size();
+            while (capacity - end < min_free) {
+                capacity *= 2;
+            }
+            storage.resize(capacity);
+        }
+    }
+    return storage.data() + end;
+}
+
+size_t ReadBuffer::free_space() const {
+    return storage.size() - end;
+}
+
+void ReadBuffer::commit(size_t bytes) {
+    end += bytes;
+}
+
+void ReadBuffer::consume(size_t bytes) {
+    begin += bytes;
+    if (begin == end) {
+        begin = end = 0; //empty, next read starts at the front for free
+    }
+}
+
+void ReadBuffer::clear() {
+    begin = end = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef READBUFFER_H
+#define READBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+//growable byte slab for a connection's incoming data. Reads land directly in the free space at the end,
+//the parser works on the unconsumed bytes in place and consumes whole frames by moving an offset; consumed
+//space is reclaimed by sliding the remainder down only when a read needs room
+class ReadBuffer {
+public:
+    explicit ReadBuffer(size_t initial_capacity);
+
+    //unconsumed bytes
+    const char* data() const;
+    size_t size() const;
+
+    //free space at the end, at least min_free bytes of it
+    char* prepare(size_t min_free);
+    size_t free_space() const;
+
+    void commit(size_t bytes); //bytes were written into the space from prepare()
+    void consume(size_t bytes);
+    void clear();
+
+private:
+    std::vector<char> storage;
+    size_t begin = 0; //first unconsumed byte
+    size_t end = 0; //one past the last byte read
+};
+
+#endif
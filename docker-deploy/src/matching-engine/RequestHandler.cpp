@@ -0,0 +1,425 @@
+#include "RequestHandler.h"
+#include <cstdio>
+#include <iostream>
+#include "Config.h"
+#include "CustomException.h"
+#include "MatchingEngine.h"
+#include "Metrics.h"
+#include "Price.h"
+
+//number conversions the way tinyxml2 did them: hex with a 0x prefix, value left untouched if unparsable
+static bool is_prefix_hex(const std::string& text) {
+    size_t i = text.find_first_not_of(" \t\n\r");
+    return i != std::string::npos && (text.compare(i, 2, "0x") == 0 || text.compare(i, 2, "0X") == 0);
+}
+
+static void to_unsigned(std::string_view value, uint32_t& out) {
+    std::string text(value);
+    unsigned parsed;
+    if (sscanf(text.c_str(), is_prefix_hex(text) ? "%x" : "%u", &parsed) == 1) {
+        out = parsed;
+    }
+}
+
+static void to_int(std::string_view value, int& out) {
+    std::string text(value);
+    if (is_prefix_hex(text)) {
+        unsigned parsed;
+        if (sscanf(text.c_str(), "%x", &parsed) == 1) {
+            out = int(parsed);
+        }
+    } else {
+        int parsed;
+        if (sscanf(text.c_str(), "%d", &parsed) == 1) {
+            out = parsed;
+        }
+    }
+}
+
+static void unsigned_attribute(const std::vector<XmlAttribute>& attributes, const char* name, uint32_t& out) {
+    if (const XmlAttribute* attribute = find_attribute(attributes, name)) {
+        to_unsigned(attribute->value, out);
+    }
+}
+
+static void int_attribute(const std::vector<XmlAttribute>& attributes, const char* name, int& out) {
+    if (const XmlAttribute* attribute = find_attribute(attributes, name)) {
+        to_int(attribute->value, out);
+    }
+}
+
+//attribute as a string (for Price::parse and echoing back), or nullptr if it is missing
+static const char* string_attribute(const std::vector<XmlAttribute>& attributes, const char* name, std::string& storage) {
+    const XmlAttribute* attribute = find_attribute(attributes, name);
+    if (attribute == nullptr) {
+        return nullptr;
+    }
+    storage.assign(attribute->value);
+    return storage.c_str();
+}
+
+//adds the canceled and executed children of a status/canceled response. Times are seconds since epoch
+static void add_order_history(ResponseWriter& response, const OrderStatus& status) {
+    if (status.canceled_shares != 0) {
+        response.open("canceled");
+        response.attribute("shares", status.canceled_shares);
+        response.attribute("time", status.canceled_time / 1000000);
+        response.close();
+    }
+
+    for (const Execution& execution : status.executions) { //can have multiple exectued trades
+        response.open("executed");
+        response.attribute("shares", execution.shares);
+        response.price_attribute("price", execution.price);
+        response.attribute("time", execution.time / 1000000);
+        response.close();
+    }
+}
+
+RequestHandler::RequestHandler(ResponseWriter& response, bool batch) : response(response), batch(batch) {
+
+}
+
+LatencyStats::RequestType RequestHandler::document_type() const {
+    return root == CREATE ? LatencyStats::CREATE : root == TRANSACTIONS ? LatencyStats::TRANSACTIONS : LatencyStats::ANY;
+}
+
+void RequestHandler::count(Metrics::Request type, const std::string& error) {
+    if (batch) {
+        batch_metrics.emplace_back(type, error);
+    } else {
+        Metrics::request(type, error);
+    }
+}
+
+//records an engine call that started at start
+void RequestHandler::executed(LatencyStats::RequestType type, LatencyStats::Clock::time_point start) {
+    LatencyStats::Clock::duration elapsed = LatencyStats::Clock::now() - start;
+    LatencyStats::record(LatencyStats::EXECUTE, type, elapsed);
+    engine += elapsed;
+}
+
+void RequestHandler::start_element(std::string_view name, const std::vector<XmlAttribute>& attributes) {
+    depth++;
+
+    if (depth == 1) {
+        if (root != NONE) {
+            return;
+        }
+        if (name == "create") {
+            root = CREATE;
+        } else if (name == "transactions") {
+            root = TRANSACTIONS;
+            unsigned_attribute(attributes, "id", transactions_id);
+            if (batch && !MatchingEngine::begin_batch()) {
+                failed = stopped = true; //run again unbatched
+            }
+        } else {
+            root = INVALID;
+        }
+        in_root = true;
+        return;
+    }
+
+    if (root == CREATE) {
+        if (depth == 2) {
+            if (name == "account") {
+                create_account(attributes);
+            } else if (name == "symbol") {
+                in_symbol = true;
+                std::string storage;
+                const char* sym = string_attribute(attributes, "sym", storage);
+                symbol = sym != nullptr ? sym : "";
+            } else {
+                std::cout << "received invalid element in create" << std::endl;
+            }
+
+        } else if (depth == 3 && in_symbol) {
+            shares_id = 0;
+            unsigned_attribute(attributes, "id", shares_id);
+            shares_text.clear();
+            shares_child_seen = false;
+
+        } else if (depth == 4) {
+            shares_child_seen = true;
+        }
+
+    } else if (root == TRANSACTIONS && depth == 2 && !stopped) {
+        if (name == "order") {
+            place_order(attributes);
+            return;
+        }
+        place_orders(); //a query or cancel may be for one of them
+        if (name == "query") {
+            query_order(attributes);
+        } else if (name == "cancel") {
+            cancel_order(attributes);
+        } else {
+            std::cout << "received invalid element in transactions" << std::endl;
+            stopped = true;
+        }
+    }
+}
+
+void RequestHandler::end_element(std::string_view /*name*/) {
+    if (root == CREATE && in_symbol) {
+        if (depth == 3) {
+            insert_shares();
+        } else if (depth == 2) {
+            in_symbol = false;
+        }
+    }
+    if (depth == 1 && in_root) {
+        in_root = false;
+        place_orders();
+        if (batch) {
+            finish_batch();
+        }
+    }
+    depth--;
+}
+
+//only the first child of a share count is its text, like tinyxml2's IntText
+void RequestHandler::text(std::string_view text) {
+    if (root == CREATE && in_symbol && depth == 3 && !shares_child_seen) {
+        shares_text.assign(text);
+        shares_child_seen = true;
+    }
+}
+
+//applies the collected creates at once, or commits the document's transaction. The responses are only
+//written once the batch succeeded; if it didn't, nothing of it was applied and the caller runs it again
+void RequestHandler::finish_batch() {
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    if (root == CREATE) {
+        bool applied = MatchingEngine::create_batch(items);
+        executed(LatencyStats::CREATE, start);
+        if (!applied) {
+            failed = true;
+            return;
+        }
+        for (const CreateItem& item : items) {
+            write_created(item);
+        }
+    } else if (root == TRANSACTIONS && !failed) {
+        failed = !MatchingEngine::end_batch();
+        executed(LatencyStats::TRANSACTIONS, start);
+    }
+
+    if (!failed) {
+        for (const auto& metric : batch_metrics) {
+            Metrics::request(metric.first, metric.second);
+        }
+    }
+    batch_metrics.clear();
+}
+
+void RequestHandler::finish() {
+    if (root == NONE) {
+        std::cout << "Root element not found" << std::endl;
+        response.open("error");
+        response.text("Root element not found.");
+        response.close();
+
+    } else if (root == INVALID) {
+        std::cout << "received invalid root element: must be create or transaction" << std::endl;
+        response.open("error");
+        response.text("Invalid root element: must be create or transactions.");
+        response.close();
+    }
+}
+
+void RequestHandler::create_account(const std::vector<XmlAttribute>& attributes) {
+    uint32_t id = 0;
+    price_t balance = 0;
+    unsigned_attribute(attributes, "id", id);
+    std::string storage;
+    const char* balance_text = string_attribute(attributes, "balance", storage);
+
+    CreateItem item{true, id, "", balance, ""};
+    if (balance_text != nullptr && !Price::parse(balance_text, item.amount)) {
+        item.error = "Invalid balance.";
+    }
+    if (item.error.empty() && item.amount < 0) {
+        item.error = "Balance cannot be negative.";
+    }
+    add_item(std::move(item));
+}
+
+void RequestHandler::insert_shares() {
+    int num_shares = 0;
+    to_int(shares_text, num_shares);
+
+    add_item(CreateItem{false, shares_id, symbol, num_shares, ""});
+}
+
+//runs a create action now, or with the rest of the document once it has been seen when batched
+void RequestHandler::add_item(CreateItem&& item) {
+    if (batch) {
+        items.push_back(std::move(item));
+        return;
+    }
+
+    if (item.error.empty()) {
+        LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+        try {
+            if (item.account) {
+                MatchingEngine::create_account(item.account_id, item.amount);
+            } else {
+                MatchingEngine::insert_shares(item.account_id, item.symbol, item.amount);
+            }
+
+        } catch (const CustomException& e) {
+            item.error = e.what();
+        } catch (const std::exception &e) {
+            std::cout << "unknown exception in " << (item.account ? "create_account: " : "insert_shares: ") << e.what() << std::endl;
+            item.error = "Unexpected error."; //general exception handling
+        }
+        executed(LatencyStats::CREATE, start);
+    }
+    write_created(item);
+}
+
+void RequestHandler::write_created(const CreateItem& item) {
+    count(item.account ? Metrics::ACCOUNT : Metrics::SHARES, item.error);
+    response.open(item.error.empty() ? "created" : "error");
+    if (!item.account) {
+        response.attribute("sym", item.symbol);
+    }
+    response.attribute("id", item.account_id);
+    if (!item.error.empty()) {
+        response.text(item.error);
+    }
+    response.close();
+}
+
+void RequestHandler::place_order(const std::vector<XmlAttribute>& attributes) {
+    std::string sym_storage;
+    const char* sym = string_attribute(attributes, "sym", sym_storage);
+
+    PendingOrder pending{OrderItem{sym != nullptr ? sym : "", 0, 0, 0, ""}, true, ""};
+    int_attribute(attributes, "amount", pending.order.amount);
+    std::string limit_storage;
+    const char* limit_text = string_attribute(attributes, "limit", limit_storage);
+    if (limit_text != nullptr && !Price::parse(limit_text, pending.order.limit)) {
+        pending.valid_limit = false;
+        pending.limit_text = limit_text; //echoed back
+        pending.order.limit = 0;
+        pending.order.error = "Invalid limit price.";
+    }
+
+    orders.push_back(std::move(pending));
+    if (batch || !Config::parallel_symbols) { //the document's transaction belongs to this thread alone
+        place_orders();
+    }
+}
+
+//places the orders seen since the last action of another kind, in one go so that MatchingEngine can run
+//those for different symbols side by side
+void RequestHandler::place_orders() {
+    if (orders.empty()) {
+        return;
+    }
+
+    std::vector<OrderItem> items;
+    for (PendingOrder& pending : orders) {
+        items.push_back(std::move(pending.order));
+    }
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    MatchingEngine::place_orders(transactions_id, items);
+    executed(LatencyStats::ORDER, start);
+
+    for (size_t i = 0; i < items.size(); i++) {
+        const OrderItem& order = items[i];
+        count(Metrics::ORDER, order.error);
+        response.open(order.error.empty() ? "opened" : "error");
+        response.attribute("sym", order.symbol);
+        response.attribute("amount", order.amount);
+        if (orders[i].valid_limit) {
+            response.price_attribute("limit", order.limit);
+        } else {
+            response.attribute("limit", orders[i].limit_text); //echo back what we couldn't parse
+        }
+
+        if (order.error.empty()) {
+            response.attribute("id", order.order_id);
+        } else {
+            response.text(order.error);
+        }
+        response.close();
+    }
+    orders.clear();
+}
+
+void RequestHandler::query_order(const std::vector<XmlAttribute>& attributes) {
+    int order_id = 0;
+    int_attribute(attributes, "id", order_id);
+
+    std::string error_message;
+    OrderStatus status;
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    try {
+        status = MatchingEngine::query_order(transactions_id, order_id);
+
+    } catch (const CustomException& e) {
+        error_message = e.what();
+    } catch (const std::exception &e) {
+        std::cout << "unknown exception in query_order: " << e.what() << std::endl;
+        error_message = "Unexpected error."; //general exception handling
+    }
+    executed(LatencyStats::QUERY, start);
+    count(Metrics::QUERY, error_message);
+
+    if (!error_message.empty()) {
+        response.open("error");
+        response.attribute("id", order_id);
+        response.text(error_message);
+        response.close();
+        return;
+    }
+
+    response.open("status");
+    response.attribute("id", order_id);
+
+    //set open, canceled, and executed elements; open is always there, even with nothing open
+    response.open("open");
+    response.attribute("shares", status.open_shares);
+    response.close();
+    add_order_history(response, status);
+    response.close();
+}
+
+void RequestHandler::cancel_order(const std::vector<XmlAttribute>& attributes) {
+    int order_id = 0;
+    int_attribute(attributes, "id", order_id);
+
+    std::string error_message;
+    OrderStatus status;
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    try {
+        status = MatchingEngine::cancel_order(transactions_id, order_id);
+
+    } catch (const CustomException& e) {
+        error_message = e.what();
+    } catch (const std::exception &e) {
+        std::cout << "unknown exception in cancel_order: " << e.what() << std::endl;
+        error_message = "Unexpected error."; //general exception handling
+    }
+    executed(LatencyStats::CANCEL, start);
+    count(Metrics::CANCEL, error_message);
+
+    if (!error_message.empty()) {
+        response.open("error");
+        response.attribute("id", order_id);
+        response.text(error_message);
+        response.close();
+        return;
+    }
+
+    response.open("canceled");
+    response.attribute("id", order_id);
+
+    //canceled, and executed elements
+    add_order_history(response, status);
+    response.close();
+}
@@ -0,0 +1,83 @@
+#ifndef REQUESTHANDLER_H
+#define REQUESTHANDLER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "LatencyStats.h"
+#include "Metrics.h"
+#include "OrderStore.h"
+#include "ResponseWriter.h"
+#include "XmlParser.h"
+
+//executes a <create> or <transactions> request as XmlParser reports it, writing a result element per action
+//to the response. Actions run in document order as soon as their element (or, for share inserts, their
+//text) has been seen, so the request is never held as a tree; consecutive orders are the exception, they
+//are collected until an action of another kind (or the end) and then placed together. Batched, the creates of a <create> are
+//collected and applied together at its end, and a <transactions> runs in one transaction
+class RequestHandler : public XmlHandler {
+public:
+    //batch (Config::document_batch): the document runs as one MatchingEngine batch
+    RequestHandler(ResponseWriter& response, bool batch);
+
+    void start_element(std::string_view name, const std::vector<XmlAttribute>& attributes) override;
+    void end_element(std::string_view name) override;
+    void text(std::string_view text) override;
+
+    //adds the error for a document without a root element, or with an unknown one
+    void finish();
+
+    //the batch couldn't be applied and had no effect; the response is incomplete and the document has to be
+    //run again without batching
+    bool batch_failed() const { return failed; }
+
+    //for LatencyStats: the root's type, and the time spent in MatchingEngine calls
+    LatencyStats::RequestType document_type() const;
+    LatencyStats::Clock::duration engine_time() const { return engine; }
+
+private:
+    enum RootType { NONE, CREATE, TRANSACTIONS, INVALID };
+
+    ResponseWriter& response;
+    bool batch;
+    bool failed = false;
+    std::vector<CreateItem> items; //creates of a batched <create>, applied at its end
+
+    struct PendingOrder {
+        OrderItem order;
+        bool valid_limit;
+        std::string limit_text; //as sent, if it isn't a valid price
+    };
+    std::vector<PendingOrder> orders; //of <transactions>, not placed yet
+
+    LatencyStats::Clock::duration engine{0};
+    void executed(LatencyStats::RequestType type, LatencyStats::Clock::time_point start);
+
+    //Metrics of a batched document's actions, only recorded once it committed; a failed batch runs again
+    std::vector<std::pair<Metrics::Request, std::string>> batch_metrics;
+    void count(Metrics::Request type, const std::string& error);
+
+    int depth = 0; //of the element being parsed, the root is 1
+    RootType root = NONE; //first top-level element; later ones are ignored
+    bool in_root = false; //inside that element
+    bool stopped = false; //an invalid transaction ends processing of the rest of the request
+
+    uint32_t transactions_id = 0; //account of <transactions>
+    bool in_symbol = false; //inside a <symbol> of <create>
+    std::string symbol; //its sym
+    uint32_t shares_id = 0; //account of the <symbol> child being parsed
+    std::string shares_text; //its first text
+    bool shares_child_seen = false; //anything after which text no longer counts as the first child
+
+    void create_account(const std::vector<XmlAttribute>& attributes);
+    void insert_shares();
+    void add_item(CreateItem&& item);
+    void write_created(const CreateItem& item);
+    void finish_batch();
+    void place_order(const std::vector<XmlAttribute>& attributes);
+    void place_orders();
+    void query_order(const std::vector<XmlAttribute>& attributes);
+    void cancel_order(const std::vector<XmlAttribute>& attributes);
+};
+
+#endif
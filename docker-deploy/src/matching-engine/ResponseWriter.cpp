@@ -0,0 +1,122 @@
+#include "ResponseWriter.h"
+#include <charconv>
+#include <cstring>
+
+#define LENGTH_PLACEHOLDER 10 //digits reserved for the length line, enough for any response
+
+ResponseWriter::ResponseWriter(std::string& out) : out(out), frame_start(out.size()) {
+    out.append(LENGTH_PLACEHOLDER + 1, ' ');
+    open("results");
+}
+
+void ResponseWriter::seal() {
+    if (tag_open) {
+        out += '>';
+        tag_open = false;
+    }
+}
+
+void ResponseWriter::open(const char* name) {
+    seal();
+    if (depth > 0 && text_depth < 0) { //the root starts the document, everything else a new indented line
+        out += '\n';
+        out.append(depth * 4, ' ');
+    }
+
+    out += '<';
+    out += name;
+    open_names[depth++] = name;
+    tag_open = true;
+}
+
+void ResponseWriter::attribute(const char* name, std::string_view value) {
+    out += ' ';
+    out += name;
+    out += "=\"";
+    write_escaped(value, true);
+    out += '"';
+}
+
+void ResponseWriter::attribute(const char* name, int64_t value) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    attribute(name, std::string_view(digits, end - digits));
+}
+
+void ResponseWriter::price_attribute(const char* name, price_t value) {
+    char digits[Price::MAX_FORMAT_LENGTH];
+    char* end = Price::format(value, digits);
+    attribute(name, std::string_view(digits, end - digits));
+}
+
+void ResponseWriter::text(std::string_view text) {
+    seal();
+    text_depth = depth - 1;
+    write_escaped(text, false);
+}
+
+void ResponseWriter::close() {
+    depth--;
+    if (tag_open) {
+        out += "/>";
+        tag_open = false;
+    } else {
+        if (text_depth < 0) {
+            out += '\n';
+            out.append(depth * 4, ' ');
+        }
+        out += "</";
+        out += open_names[depth];
+        out += '>';
+    }
+
+    if (text_depth == depth) {
+        text_depth = -1;
+    }
+}
+
+ResponseWriter::Mark ResponseWriter::mark() const {
+    return Mark{out.size(), tag_open, text_depth};
+}
+
+void ResponseWriter::rewind(const Mark& position) {
+    out.resize(position.size);
+    tag_open = position.tag_open;
+    text_depth = position.text_depth;
+}
+
+void ResponseWriter::finish() {
+    close();
+    out += '\n';
+
+    //the length goes at the end of the placeholder, then the unused front of it is cut out
+    size_t xml_length = out.size() - frame_start - LENGTH_PLACEHOLDER - 1;
+    char digits[LENGTH_PLACEHOLDER];
+    char* end = std::to_chars(digits, digits + sizeof(digits), xml_length).ptr;
+    size_t length_digits = end - digits;
+    char* line = &out[frame_start + LENGTH_PLACEHOLDER - length_digits];
+    std::memcpy(line, digits, length_digits);
+    line[length_digits] = '\n';
+    out.erase(frame_start, LENGTH_PLACEHOLDER - length_digits);
+}
+
+//tinyxml2's escaping: all five entities in attribute values, only & < > in text
+void ResponseWriter::write_escaped(std::string_view value, bool attribute) {
+    size_t plain = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        const char* entity = nullptr;
+        switch (value[i]) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = attribute ? "&quot;" : nullptr; break;
+            case '\'': entity = attribute ? "&apos;" : nullptr; break;
+        }
+        if (entity != nullptr) {
+            out.append(value.data() + plain, i - plain);
+            out += entity;
+            plain = i + 1;
+        }
+    }
+    out.append(value.data() + plain, value.size() - plain);
+}
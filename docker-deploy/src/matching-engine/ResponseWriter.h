@@ -0,0 +1,52 @@
+#ifndef RESPONSEWRITER_H
+#define RESPONSEWRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "Price.h"
+
+#define MAX_RESPONSE_DEPTH 4 //results > status > executed, plus one spare
+
+//writes one response frame, "<xml length>\n<results>...</results>\n", straight onto the end of out in a
+//single pass. The output is what tinyxml2's XMLPrinter printed for the same elements (4 space indents, text
+//kept on the element's line, empty elements as <x/>) so clients see no difference. Element and attribute
+//names have to be literals that stay valid until the element is closed; values are escaped. Nothing is
+//allocated once out has grown to the connection's usual batch size
+class ResponseWriter {
+public:
+    //starts the frame with room for the length line and opens <results>
+    explicit ResponseWriter(std::string& out);
+
+    void open(const char* name);
+    void attribute(const char* name, std::string_view value);
+    void attribute(const char* name, int64_t value);
+    void price_attribute(const char* name, price_t value);
+    void text(std::string_view text);
+    void close();
+
+    //closes <results> and fills in the length line
+    void finish();
+
+    //position to cut the output back to, for elements written at the same depth that have to be dropped again
+    struct Mark {
+        size_t size;
+        bool tag_open;
+        int text_depth;
+    };
+    Mark mark() const;
+    void rewind(const Mark& position);
+
+private:
+    std::string& out;
+    size_t frame_start; //of the length line placeholder
+    const char* open_names[MAX_RESPONSE_DEPTH];
+    int depth = 0; //open elements, <results> included
+    bool tag_open = false; //the innermost start tag still needs its ">" (or "/>")
+    int text_depth = -1; //depth of the element whose text was written, its end tag goes on the same line
+
+    void seal();
+    void write_escaped(std::string_view value, bool attribute);
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "Snapshot.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "AccountStore.h"
+#include "Binary.h"
+#include "Config.h"
+#include "Journal.h"
+#include "MatchingEngine.h"
+#include "OrderStore.h"
+
+#define SNAPSHOT_MAGIC "MESNAP01"
+#define SNAPSHOT_HEADER 36 //magic 8, seq 8, offset 8, length 8, crc 4
+
+std::mutex Snapshot::mutex;
+std::condition_variable Snapshot::stopping;
+bool Snapshot::running = false;
+uint64_t Snapshot::last_seq = 0;
+std::thread Snapshot::thread;
+
+//writes all of data, retrying short writes
+static bool write_all(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t bytes = ::write(fd, data.data() + written, data.size() - written);
+        if (bytes < 0 && errno != EINTR) {
+            return false;
+        }
+        written += bytes > 0 ? bytes : 0;
+    }
+    return true;
+}
+
+bool Snapshot::load(const std::string& path, uint64_t& seq, uint64_t& journal_offset) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "snapshot: none at " << path << ", replaying the whole journal" << std::endl;
+        return false;
+    }
+
+    std::string data;
+    std::vector<char> chunk(1 << 20);
+    ssize_t bytes;
+    while ((bytes = ::read(fd, chunk.data(), chunk.size())) > 0) {
+        data.append(chunk.data(), bytes);
+    }
+    ::close(fd);
+
+    //a bad snapshot only costs time: the journal still has everything
+    if (bytes < 0 || data.size() < SNAPSHOT_HEADER || data.compare(0, 8, SNAPSHOT_MAGIC) != 0) {
+        std::cout << "snapshot: " << path << " is unreadable, replaying the whole journal" << std::endl;
+        return false;
+    }
+    BinaryReader header(data.data() + 8, SNAPSHOT_HEADER - 8);
+    uint64_t snapshot_seq = header.get<uint64_t>();
+    uint64_t offset = header.get<uint64_t>();
+    uint64_t length = header.get<uint64_t>();
+    uint32_t crc = header.get<uint32_t>();
+    if (data.size() - SNAPSHOT_HEADER != length || crc32(data.data() + SNAPSHOT_HEADER, length) != crc) {
+        std::cout << "snapshot: " << path << " is corrupt, replaying the whole journal" << std::endl;
+        return false;
+    }
+
+    BinaryReader body(data.data() + SNAPSHOT_HEADER, length);
+    AccountStore::load(body);
+    OrderStore::load(body);
+    MatchingEngine::load_symbols(body);
+
+    seq = last_seq = snapshot_seq;
+    journal_offset = offset;
+    std::cout << "snapshot: loaded " << path << " at seq " << seq << std::endl;
+    return true;
+}
+
+void Snapshot::start() {
+    if (Config::snapshot_path.empty()) {
+        return;
+    }
+    running = true;
+    thread = std::thread(&Snapshot::run);
+}
+
+void Snapshot::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    stopping.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Snapshot::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        stopping.wait_for(lock, std::chrono::seconds(1));
+        if (running && Journal::last_seq() - last_seq >= Config::snapshot_events) {
+            lock.unlock();
+            take();
+            lock.lock();
+        }
+    }
+}
+
+void Snapshot::take() {
+    auto started = std::chrono::steady_clock::now();
+    std::string temp_path = Config::snapshot_path + ".tmp";
+    uint64_t seq, offset;
+    pid_t child = -1;
+
+    //fork at a point where no shard is mid-task; the child has a consistent image of memory as of seq
+    MatchingEngine::quiesce([&]() {
+        Journal::position(seq, offset);
+        child = fork();
+        if (child == 0) {
+            _exit(write(temp_path, seq, offset) ? 0 : 1); //no destructors/atexit handlers of the parent's objects
+        }
+    });
+    auto resumed = std::chrono::steady_clock::now();
+
+    if (child < 0) {
+        std::cout << "snapshot: fork failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    int status = 0;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << "snapshot: writing " << temp_path << " failed" << std::endl;
+        return;
+    }
+
+    //a snapshot must never be ahead of the journal on disk, or a crash would leave a gap after it
+    Journal::wait_durable(seq);
+    if (rename(temp_path.c_str(), Config::snapshot_path.c_str()) != 0) {
+        std::cout << "snapshot: rename failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        last_seq = seq;
+    }
+    auto done = std::chrono::steady_clock::now();
+    std::cout << "snapshot: seq " << seq << ", matching paused "
+              << std::chrono::duration_cast<std::chrono::microseconds>(resumed - started).count() << "us, written in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(done - started).count() << "ms" << std::endl;
+}
+
+bool Snapshot::write(const std::string& path, uint64_t seq, uint64_t journal_offset) {
+    std::string body;
+    AccountStore::save(body);
+    OrderStore::save(body);
+    MatchingEngine::save_symbols(body);
+
+    std::string out(SNAPSHOT_MAGIC);
+    put<uint64_t>(out, seq);
+    put<uint64_t>(out, journal_offset);
+    put<uint64_t>(out, body.size());
+    put<uint32_t>(out, crc32(body.data(), body.size()));
+    out += body;
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_all(fd, out) && fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+}
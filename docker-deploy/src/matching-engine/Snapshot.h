@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//periodic binary image of the engine state (accounts, order records, holdings, id counter) so a restart
+//loads it and replays only the journal after it. The state is captured by fork(): matching is paused only
+//for the fork itself, and the child writes its copy-on-write view of memory while the parent keeps going.
+//
+//file format: magic, u64 journal seq, u64 journal offset, u64 body length, u32 crc32 of body, body
+class Snapshot {
+public:
+    //loads the snapshot into the stores and shards; false if there is none or it is unreadable
+    static bool load(const std::string& path, uint64_t& seq, uint64_t& journal_offset);
+
+    static void start(); //starts the thread taking a snapshot every Config::snapshot_events journal events
+    static void stop();
+
+    static void take();
+
+private:
+    static std::mutex mutex;
+    static std::condition_variable stopping;
+    static bool running;
+    static uint64_t last_seq; //journal seq of the newest snapshot on disk
+    static std::thread thread;
+
+    static void run();
+    static bool write(const std::string& path, uint64_t seq, uint64_t journal_offset); //runs in the child
+};
+
+#endif
@@ -1,412 +1,305 @@
 #include "TcpConnection.h"
+#include <cstring>
 #include <iostream>
-#include <sstream>
-#include "tinyxml2.h"
+#include <stdexcept>
 #include <vector>
-#include "DatabaseTransactions.h"
-#include "CustomException.h"
+#include "BinaryHandler.h"
+#include "Config.h"
+#include "DatabaseWorkers.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "RequestHandler.h"
+#include "ResponseWriter.h"
 
-TcpConnection::TcpConnection(boost::asio::io_context& io_context) : socket(io_context) {
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TcpConnection::TcpConnection(boost::asio::io_context& io_context, Protocol protocol) : socket(io_context), protocol(protocol), input(READ_CHUNK), strand(boost::asio::make_strand(io_context)),
+    output_ready(io_context, boost::asio::steady_timer::time_point::max()), output_drained(io_context, boost::asio::steady_timer::time_point::max()) {
 
 }
 
-TcpConnection::ptr TcpConnection::create(boost::asio::io_context& io_context) {
-    return TcpConnection::ptr(new TcpConnection(io_context)); //shared ptr
+TcpConnection::~TcpConnection() {
+    if (started) {
+        Metrics::open_connections--;
+    }
 }
 
-void TcpConnection::start() {
-    auto self = shared_from_this(); //creates reference to shared_ptr to increase ref count until async_read finishes
+TcpConnection::ptr TcpConnection::create(boost::asio::io_context& io_context, Protocol protocol) {
+    return TcpConnection::ptr(new TcpConnection(io_context, protocol)); //shared ptr
+}
 
-    //async task to read from a socket, once gets data over socket will dispatch a thread to do completion handler
-    socket.async_read_some(boost::asio::buffer(buffer),
-        [self](const boost::system::error_code& error, size_t bytes) {self->handle_read(error, bytes);});
+//the reader and the writer run on the connection's strand, so they never run at the same time and share the
+//connection's state without locks. Each holds one reference to the connection for as long as it runs
+void TcpConnection::start() {
+    started = true;
+    Metrics::open_connections++;
+    auto self = shared_from_this();
+    boost::asio::co_spawn(strand, [self]() { return self->reader(); }, boost::asio::detached);
+    boost::asio::co_spawn(strand, [self]() { return self->writer(); }, boost::asio::detached);
 }
 
-void TcpConnection::handle_read(const boost::system::error_code& error, size_t bytes) {
-    if (error) { //prob just EOF since connection closed, don't register another async_read_some
-        //std::cout << error.message() << std::endl;
-        return;
-    }
+//resumes on the awaiting coroutine's executor once task has run on a database worker
+template <typename Task>
+static awaitable<void> on_database_worker(Task task) {
+    auto initiate = [task](auto handler) mutable {
+        DatabaseWorkers::post([task = std::move(task), handler = std::move(handler)]() mutable {
+            task();
+            boost::asio::post(std::move(handler)); //to the handler's associated executor, the strand
+        });
+    };
+    co_await boost::asio::async_initiate<decltype(use_awaitable), void()>(std::move(initiate), use_awaitable);
+}
 
+//read, execute, queue the responses for the writer; until the client goes away
+awaitable<void> TcpConnection::reader() {
     try {
-        message += std::string(buffer, bytes);
+        while (true) {
+            //reads straight into the free space of the input buffer
+            char* free = input.prepare(READ_CHUNK);
+            size_t bytes = co_await socket.async_read_some(boost::asio::buffer(free, input.free_space()), use_awaitable);
+            input.commit(bytes);
+            received = LatencyStats::Clock::now();
+            Metrics::reads_in_progress++;
+
+            //Responses are written into a buffer an earlier write has finished with, so its capacity is reused
+            std::string responses;
+            if (!spare.empty()) {
+                responses.swap(spare.back());
+                spare.pop_back();
+            }
 
-        //do some computation on the message
-        parse_message();
+            //the requests run on a database worker, so this io thread serves other sockets meanwhile: their SQL
+            //with the DATABASE backend, and with the MEMORY backend the waits for matching shards (which may be
+            //busy with a sweep or parked for a snapshot) and for durability
+            co_await on_database_worker([this, &responses]() {
+                execute_requests(responses);
 
-    } catch (const std::exception& e) {
-        std::cout << "Uncaught exception in handle_read/parse_message: " << e.what() << std::endl;
-        message.clear(); //just keep going after clearing currently collected socket data
-    }
+                //don't ack anything that isn't as durable as configured yet; one wait, up to the last event these
+                //requests appended or saw on a shard, covers every pipelined request. Buffered has nothing to wait for
+                if (Config::backend == Config::MEMORY && !responses.empty() && Config::durability != Config::BUFFERED) {
+                    Journal::sync(Journal::thread_seq());
+                }
+            });
+
+            Metrics::reads_in_progress--;
+            if (!responses.empty()) {
+                queue_response(std::move(responses)); // send the results back to the client
+            } else {
+                recycle(std::move(responses));
+            }
 
-    auto self = shared_from_this(); //creates new shared_ptr to increase ref count until async_read finishes
+            //backpressure: a client that doesn't read its responses doesn't get to send more requests
+            while (queued_bytes > OUTPUT_QUEUE_LIMIT && !closed) {
+                boost::system::error_code ignored;
+                co_await output_drained.async_wait(boost::asio::redirect_error(use_awaitable, ignored));
+            }
+            if (closed) {
+                break;
+            }
+        }
 
-    //async task to read from a socket, once gets data over socket will dispatch a thread to do completion handler
-    socket.async_read_some(boost::asio::buffer(buffer),
-        [self](const boost::system::error_code& error, size_t bytes) {self->handle_read(error, bytes);});
+    } catch (const boost::system::system_error& e) { //prob just EOF since connection closed
+        //std::cout << e.what() << std::endl;
+    }
 
+    closed = true;
+    output_ready.cancel(); //the writer sends what is queued, then stops
 }
 
+//sends everything queued so far with one gathered write, for as long as the reader queues responses
+awaitable<void> TcpConnection::writer() {
+    try {
+        while (true) {
+            while (outbox.empty() && !closed) {
+                boost::system::error_code ignored;
+                co_await output_ready.async_wait(boost::asio::redirect_error(use_awaitable, ignored));
+            }
+            if (outbox.empty()) {
+                break;
+            }
 
-int TcpConnection::parse_message() {
-    if (message.find("\n") == std::string::npos) {
-        return -1;
+            writing.swap(outbox);
+            writing_times.swap(outbox_times);
+            size_t bytes;
+            if (writing.size() == 1) { //usually a single buffer, which doesn't need a buffer sequence allocated
+                bytes = co_await boost::asio::async_write(socket, boost::asio::buffer(writing.front()), use_awaitable);
+            } else {
+                std::vector<boost::asio::const_buffer> buffers;
+                buffers.reserve(writing.size());
+                for (const std::string& response : writing) {
+                    buffers.push_back(boost::asio::buffer(response));
+                }
+                bytes = co_await boost::asio::async_write(socket, buffers, use_awaitable);
+            }
+
+            queued_bytes -= bytes;
+            for (LatencyStats::Clock::time_point queued : writing_times) {
+                LatencyStats::record_since(LatencyStats::WRITE, LatencyStats::ANY, queued);
+            }
+            for (std::string& response : writing) {
+                recycle(std::move(response));
+            }
+            writing.clear();
+            writing_times.clear();
+            output_drained.cancel(); //wakes a reader waiting on backpressure
+        }
+
+    } catch (const boost::system::system_error& e) { //client went away, the pending read fails too
+        boost::system::error_code ignored;
+        socket.close(ignored);
     }
 
-    std::istringstream message_stream(message);
-    std::string line;
+    closed = true;
+    output_drained.cancel();
+}
 
-    std::getline(message_stream, line);
-    uint32_t xml_len = std::stoul(line);
-    int xml_start = line.length() + 1; //index of start of xml
+void TcpConnection::queue_response(std::string&& response) {
+    queued_bytes += response.size();
+    outbox.push_back(std::move(response));
+    outbox_times.push_back(LatencyStats::Clock::now());
+    output_ready.cancel(); //wakes the writer if it is idle
+}
 
-    if (xml_start + xml_len > message.length()) { //haven't received full XML
-        //std::cout << "haven received full xml" << std::endl;
-        return -1;
-    }
-    
-    //extract the actual xml, so remove anything like "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-    std::getline(message_stream, line);
-    if (line.find("xml version") != std::string::npos) {
-        xml_start += line.length() + 1;
+//keeps a few emptied response buffers for the next reads, capacity and all
+void TcpConnection::recycle(std::string&& buffer) {
+    if (spare.size() < MAX_SPARE_BUFFERS) {
+        buffer.clear();
+        spare.push_back(std::move(buffer));
     }
+}
 
+//answers every complete request in the buffer, in order; a trailing partial one waits for the next read
+void TcpConnection::execute_requests(std::string& responses) {
+    try {
+        if (protocol == BINARY) {
+            while (parse_binary_message(responses) > 0) {
+            }
+        } else {
+            while (parse_message(responses) > 0) {
+            }
+        }
 
-    tinyxml2::XMLDocument doc;
-    tinyxml2::XMLError eResult = doc.Parse(message_stream.str().substr(xml_start).c_str());
+    } catch (const std::exception& e) {
+        std::cout << "Uncaught exception in handle_read/parse_message: " << e.what() << std::endl;
+        input.clear(); //just keep going after clearing currently collected socket data
+        frame_header = frame_size = 0;
+    }
+}
 
-    if (eResult != tinyxml2::XML_SUCCESS) {
-        std::cout << "Error parsing XML: " << doc.ErrorStr() << std::endl;
-        message.clear();
+//handles the binary message at the front of input (BinaryProtocol.h), appending its responses. Returns -1
+//if the message isn't complete yet; throws if its length can't even hold a header
+int TcpConnection::parse_binary_message(std::string& responses) {
+    if (input.size() < sizeof(BinaryHeader)) {
         return -1;
     }
 
-    tinyxml2::XMLNode* root = doc.FirstChildElement();
-    if (root == nullptr) {
-        std::cout << "Root element not found" << std::endl;
-        message.clear();
+    BinaryHeader header;
+    std::memcpy(&header, input.data(), sizeof(header));
+    if (header.length < sizeof(BinaryHeader)) {
+        throw std::runtime_error("invalid binary message length");
+    }
+    if (input.size() < header.length) {
+        input.prepare(header.length - input.size());
         return -1;
     }
 
-    tinyxml2::XMLDocument responseDoc;
-    tinyxml2::XMLElement* respRoot = responseDoc.NewElement("results");
-    responseDoc.InsertFirstChild(respRoot);
-
-    if (std::string(root->Value()) == "create") {
-        for (tinyxml2::XMLElement* element = root->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
-
-            if (std::string(element->Value()) == "account") {
-                uint32_t id = 0;
-                float balance = 0;
-                element->QueryUnsignedAttribute("id", &id);
-                element->QueryFloatAttribute("balance", &balance);
-
-                std::string error_message; //used for more user-freindly error messages
-                //probably call create_account here
-                try {
-                    DatabaseTransactions::create_account(id, balance);
-
-                } catch (const pqxx::sql_error &e) {
-                    //std::cout << "psql error in create_account: " << e.what() << std::endl;
-                    error_message = e.what();
-
-                } catch (const std::exception &e) {
-                    std::cout << "unknown exception in create_account: " << e.what() << std::endl;
-                    error_message = e.what();
-                }
-
-                tinyxml2::XMLElement* child;
-                if (error_message.empty()) {
-                    child = responseDoc.NewElement("created");
-                } else {
-                    child = responseDoc.NewElement("error");
-
-                    if (error_message.find("duplicate key value violates unique constraint") != std::string::npos) {
-                        error_message = "Account already exists.";
-                    } else if (error_message.find("violates check constraint") != std::string::npos) {
-                        error_message = "Balance cannot be negative.";
-                    } else {
-                        error_message = "Unexpected error."; //general exception handling
-                    }
-
-                    child->SetText(error_message.c_str());
-                }
-                
-                child->SetAttribute("id", id);
-                respRoot->InsertEndChild(child);
-                
-
-            } else if (std::string(element->Value()) == "symbol") {
-                const char* sym = nullptr;
-                element->QueryStringAttribute("sym", &sym);
-                std::string symbol_name (sym);
-                
-                //get all children account elements
-                for (tinyxml2::XMLElement* element2 = element->FirstChildElement(); element2 != nullptr; element2 = element2->NextSiblingElement()) {
-                    uint32_t id = 0;
-                    element2->QueryUnsignedAttribute("id", &id);
-
-                    int num_shares = element2->IntText();
-
-                    //probably call insert_shares here
-                    std::string error_message;
-                    try {
-                        DatabaseTransactions::insert_shares(id, symbol_name, num_shares);
-                        
-                    } catch (const pqxx::sql_error &e) {
-                        //std::cout << "psql error in insert_shares: " << e.what() << std::endl;
-                        error_message = e.what();
-                    } catch (const std::exception &e) {
-                        std::cout << "unknown exception in insert_shares: " << e.what() << std::endl;
-                        error_message = e.what();
-                    }
-
-                    tinyxml2::XMLElement* child;
-                    if (error_message.empty()) {
-                        child = responseDoc.NewElement("created");
-                    } else {
-                        child = responseDoc.NewElement("error");
-
-                        if (error_message.find("violates foreign key constraint") != std::string::npos) {
-                            error_message = "Account does not exist.";
-                        } else if (error_message.find("violates check constraint") != std::string::npos) {
-                            error_message = "Number of shares cannot be negative.";
-                        } else {
-                            error_message = "Unexpected error."; //general exception handling
-                        }
-
-                        child->SetText(error_message.c_str());
-                    }
-
-                    child->SetAttribute("sym", sym);
-                    child->SetAttribute("id", id);
-                    respRoot->InsertEndChild(child);
-                    
-                }
-
+    LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+    BinaryHandler::execute(input.data(), header.length, responses);
+    LatencyStats::record_since(LatencyStats::EXECUTE, LatencyStats::BINARY, start);
+    input.consume(header.length);
+    return 1;
+}
 
-            } else {
-                std::cout << "received invalid element in create" << std::endl;
-            }
-    
+//handles the request frame at the front of input, "<xml length>\n<xml>", appending its response frame to
+//responses. Returns -1 if the frame isn't complete yet; throws if the length line is garbage, as there is
+//no way to find the next frame after that. The length line is parsed once per frame, not once per read
+int TcpConnection::parse_message(std::string& responses) {
+    if (frame_size == 0) {
+        const char* data = input.data();
+        size_t length_digits = 0;
+        size_t xml_len = 0;
+        while (length_digits < input.size() && data[length_digits] >= '0' && data[length_digits] <= '9' &&
+               length_digits < MAX_LENGTH_DIGITS) {
+            xml_len = xml_len * 10 + (data[length_digits] - '0');
+            length_digits++;
         }
 
-    } else if (std::string(root->Value()) == "transactions") {
-        uint32_t id = 0;
-        root->ToElement()->QueryUnsignedAttribute("id", &id);
-
-        for (tinyxml2::XMLElement* element = root->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
-
-            if (std::string(element->Value()) == "order") {
-                const char* sym = nullptr;
-                element->QueryStringAttribute("sym", &sym);
-                std::string symbol_name (sym);
-
-                int amount = 0;
-                float limit = 0;
-                element->QueryIntAttribute("amount", &amount);
-                element->QueryFloatAttribute("limit", &limit);
-
-                std::string error_message;
-                int order_id = 0;
-                try {
-                    order_id = DatabaseTransactions::place_order(id, symbol_name, amount, limit);
-                    
-                } catch (const CustomException& e) {
-                    //std::cout << "psql error in place_order: " << e.what() << std::endl;
-                    error_message = e.what();
-                } catch (const std::exception &e) {
-                    std::cout << "unknown exception in place_order: " << e.what() << std::endl;
-                    error_message = "Unexpected error."; //general exception handling
-                }
-
-                tinyxml2::XMLElement* child;
-                if (error_message.empty()) {
-                    child = responseDoc.NewElement("opened");
-
-                    child->SetAttribute("sym", sym);
-                    child->SetAttribute("amount", amount);
-                    child->SetAttribute("limit", limit);
-                    child->SetAttribute("id", order_id);
-                } else {
-                    child = responseDoc.NewElement("error");
-
-                    child->SetAttribute("sym", sym);
-                    child->SetAttribute("amount", amount);
-                    child->SetAttribute("limit", limit);
-
-                    child->SetText(error_message.c_str());
-                }
-
-                respRoot->InsertEndChild(child);
-
-
-            } else if (std::string(element->Value()) == "query") {
-                int order_id = 0;
-                element->QueryIntAttribute("id", &order_id);
-
-                std::string error_message;
-                std::vector<pqxx::result> orderRes;
-                try {
-                    orderRes = DatabaseTransactions::query_order(id, order_id); //vector with 2 pqxx::result elements
-                    
-                } catch (const CustomException& e) {
-                    //std::cout << "psql error in query_order: " << e.what() << std::endl;
-                    error_message = e.what();
-                } catch (const std::exception &e) {
-                    std::cout << "unknown exception in query_order: " << e.what() << std::endl;
-                    error_message = "Unexpected error."; //general exception handling
-                }
-
-                tinyxml2::XMLElement* child;
-                if (error_message.empty()) {
-                    child = responseDoc.NewElement("status");
-
-                } else {
-                    child = responseDoc.NewElement("error");
-
-                    child->SetAttribute("id", order_id);
-                    child->SetText(error_message.c_str());
-                    respRoot->InsertEndChild(child);
-                    continue;
-                }
-
-                child->SetAttribute("id", order_id);
-                respRoot->InsertEndChild(child);
-
-                //set open, canceled, and executed elements
-                pqxx::result orderEntry = orderRes[0];
-                pqxx::result tradesEntry = orderRes[1];
-
-                int originalShares = orderEntry[0]["original_shares"].as<int>();
-                int openShares = orderEntry[0]["open_shares"].as<int>();
-                float limitPrice = orderEntry[0]["limit_price"].as<float>();
-                std::string timestamp2 = orderEntry[0]["timestamp"].as<std::string>();
-
-                tinyxml2::XMLElement* child4 = responseDoc.NewElement("open");
-                child4->SetAttribute("shares", openShares);
-                child->InsertEndChild(child4);
-
-                int totalExecuted = 0;
-                for (const auto& row : tradesEntry) { //can have multiple exectued trades
-                    int tradeId = row["trade_id"].as<int>();
-                    int tradedShares = row["traded_shares"].as<int>();
-                    float price = row["price"].as<float>();
-                    std::string timestamp = row["timestamp"].as<std::string>();
-
-                    tinyxml2::XMLElement* child2 = responseDoc.NewElement("executed");
-                    child2->SetAttribute("shares", tradedShares);
-                    child2->SetAttribute("price", price);
-                    child2->SetAttribute("time", timestamp.c_str());
-
-                    child->InsertEndChild(child2);
-
-
-                    totalExecuted += tradedShares;
-                
-                }
-
-                int canceled = originalShares - openShares - totalExecuted;
-                if (canceled != 0) {
-                    tinyxml2::XMLElement* child3 = responseDoc.NewElement("canceled");
-                    child3->SetAttribute("shares", canceled);
-                    child3->SetAttribute("time", timestamp2.c_str()); //timestamp in orders will be updated if cancel an order
-                    child->InsertEndChild(child3);
-                }
-
-
-            } else if (std::string(element->Value()) == "cancel") {
-                int order_id = 0;
-                element->QueryIntAttribute("id", &order_id);
-
-                std::string error_message;
-                std::vector<pqxx::result> orderRes;
-                try {
-                    orderRes = DatabaseTransactions::cancel_order(id, order_id); //vector with 2 pqxx::result elements
-                    
-                } catch (const CustomException& e) {
-                    //std::cout << "psql error in query_order: " << e.what() << std::endl;
-                    error_message = e.what();
-                } catch (const std::exception &e) {
-                    std::cout << "unknown exception in query_order: " << e.what() << std::endl;
-                    error_message = "Unexpected error."; //general exception handling
-                }
-
-                tinyxml2::XMLElement* child;
-                if (error_message.empty()) {
-                    child = responseDoc.NewElement("canceled");
-
-                } else {
-                    child = responseDoc.NewElement("error");
-
-                    child->SetAttribute("id", order_id);
-                    child->SetText(error_message.c_str());
-                    respRoot->InsertEndChild(child);
-                    continue;
-                }
-
-                child->SetAttribute("id", order_id);
-                respRoot->InsertEndChild(child);
-
-                //canceled, and executed elements
-                pqxx::result orderEntry = orderRes[0];
-                pqxx::result tradesEntry = orderRes[1];
-
-                int originalShares = orderEntry[0]["original_shares"].as<int>();
-                std::string timestamp2 = orderEntry[0]["timestamp"].as<std::string>();
-
-                int totalExecuted = 0;
-                for (const auto& row : tradesEntry) { //can have multiple exectued trades
-                    int tradeId = row["trade_id"].as<int>();
-                    int tradedShares = row["traded_shares"].as<int>();
-                    float price = row["price"].as<float>();
-                    std::string timestamp = row["timestamp"].as<std::string>();
-
-                    tinyxml2::XMLElement* child2 = responseDoc.NewElement("executed");
-                    child2->SetAttribute("shares", tradedShares);
-                    child2->SetAttribute("price", price);
-                    child2->SetAttribute("time", timestamp.c_str());
+        if (length_digits == input.size()) {
+            return -1; //rest of the length line still to come
+        }
+        if (length_digits == 0 || data[length_digits] != '\n') {
+            throw std::runtime_error("invalid request length line");
+        }
+        if (xml_len > MAX_REQUEST_BYTES) {
+            throw std::runtime_error("request too large");
+        }
+        frame_header = length_digits + 1;
+        frame_size = frame_header + xml_len;
+    }
 
-                    child->InsertEndChild(child2);
+    if (input.size() < frame_size) { //haven't received full XML
+        input.prepare(frame_size - input.size()); //make room for all of it now instead of growing per read
+        return -1;
+    }
 
+    //the xml is parsed where it was read, then the whole frame is consumed whatever happens below
+    const char* xml = input.data() + frame_header;
+    size_t xml_len = frame_size - frame_header;
+    struct ConsumeFrame {
+        TcpConnection& connection;
+        ~ConsumeFrame() {
+            connection.input.consume(connection.frame_size);
+            connection.frame_header = connection.frame_size = 0;
+        }
+    } consume_frame{*this};
 
-                    totalExecuted += tradedShares;
-                
+    //the response is written straight after the ones before it; a half written one is cut off again
+    size_t response_start = responses.size();
+    try {
+        ResponseWriter response(responses);
+
+        //parsed once and recorded, so a malformed request has no effect, then executed from the recording
+        bool valid = parser.record(xml, xml_len);
+        LatencyStats::Clock::time_point parsed = LatencyStats::Clock::now();
+        if (!valid) {
+            LatencyStats::record(LatencyStats::PARSE, LatencyStats::ANY, parsed - received);
+            std::cout << "Error parsing XML" << std::endl;
+            //still answered, so pipelined responses stay paired with their requests
+            response.open("error");
+            response.text("Invalid XML.");
+            response.close();
+
+        } else {
+            //a failed batch left no effects behind, so its partial response is dropped and it runs unbatched
+            ResponseWriter::Mark body_start = response.mark();
+            bool batch = Config::document_batch && Config::backend == Config::DATABASE;
+            while (true) {
+                LatencyStats::Clock::time_point start = LatencyStats::Clock::now();
+                RequestHandler handler(response, batch);
+                parser.replay(handler);
+                handler.finish();
+                if (!handler.batch_failed()) {
+                    LatencyStats::record(LatencyStats::PARSE, handler.document_type(), parsed - received);
+                    LatencyStats::record(LatencyStats::SERIALIZE, handler.document_type(),
+                                         LatencyStats::Clock::now() - start - handler.engine_time());
+                    break;
                 }
-
-                int canceled = originalShares - totalExecuted;
-                tinyxml2::XMLElement* child3 = responseDoc.NewElement("canceled");
-                child3->SetAttribute("shares", canceled);
-                child3->SetAttribute("time", timestamp2.c_str()); //timestamp in orders will be updated if cancel an order
-                child->InsertEndChild(child3);
-
-            } else {
-                std::cout << "received invalid element in transactions" << std::endl;
-                break;
+                response.rewind(body_start);
+                batch = false;
             }
-    
         }
 
-    } else {
-        std::cout << "received invalid root element: must be create or transaction" << std::endl;
-        message.clear();
-        return -1;
-    }
+        response.finish();
 
-    //create string from xmlResponse
-    tinyxml2::XMLPrinter printer;
-    responseDoc.Print(&printer);
-    std::string responseString = printer.CStr();
-    responseString = std::to_string(responseString.size()) + "\n" + responseString; //add length of xml to start
-
-    // send the result back to the client
-    boost::asio::write(socket, boost::asio::buffer(responseString.c_str(), responseString.length()));
+    } catch (...) {
+        responses.resize(response_start);
+        throw;
+    }
 
     //can remove when doing load testing
     // std::cout << "response xml: " << std::endl;
-    // std::cout << responseString << std::endl;
-
-    message.clear();
+    // std::cout << responses.substr(response_start) << std::endl;
 
     return 1;
 
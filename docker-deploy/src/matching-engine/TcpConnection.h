@@ -1,29 +1,69 @@
 #ifndef TCPCONNECTION_H
 #define TCPCONNECTION_H
 
+#include <utility> //before asio: boost 1.74's awaitable.hpp uses std::exchange without including it
 #include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
 #include <pqxx/pqxx>
+#include <string>
+#include <vector>
+#include "LatencyStats.h"
+#include "ReadBuffer.h"
+#include "XmlParser.h"
+
+#define MAX_LENGTH_DIGITS 10 //longest request length line accepted
+#define MAX_REQUEST_BYTES (64 << 20) //larger requests are refused rather than buffered
+#define READ_CHUNK 65536 //free space offered to each read
+#define OUTPUT_QUEUE_LIMIT (1 << 20) //bytes of unsent responses before a connection stops reading
+#define MAX_SPARE_BUFFERS 2 //written response buffers kept for reuse
 
 class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
     typedef std::shared_ptr<TcpConnection> ptr;
     typedef std::shared_ptr<pqxx::connection> db_ptr;
 
+    enum Protocol {
+        XML, //"<length>\n<xml>" frames, answered with <results>
+        BINARY //fixed layout messages of BinaryProtocol.h
+    };
 
     boost::asio::ip::tcp::socket socket;
-    char buffer[4096]; //buffer to read data into from async_read_some
-    std::string message; //holds the total message read over a series of async_read_some
+    Protocol protocol; //fixed by the port the client connected to
+    ReadBuffer input; //bytes read over a series of async_read_some, from the start of the next frame on
+    size_t frame_header = 0; //length line size of the frame at the front of input, 0 until it has been parsed
+    size_t frame_size = 0; //length line + xml
+    XmlParser parser; //keeps its scratch space between requests
+    LatencyStats::Clock::time_point received; //when the last read completed
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand; //runs the reader and the writer
+    std::vector<std::string> outbox; //responses waiting for the current write to finish
+    std::vector<std::string> writing; //responses of the write in progress
+    std::vector<LatencyStats::Clock::time_point> outbox_times, writing_times; //when each was queued
+    std::vector<std::string> spare; //written buffers, emptied, to write the next responses into
+    size_t queued_bytes = 0; //outbox + writing
+    bool closed = false; //reader or writer is done, the other one stops too
+    bool started = false; //counted in Metrics::open_connections
 
-    static ptr create(boost::asio::io_context& io_context);
+    //never expiring timers used as signals between the coroutines: cancel() wakes the one waiting
+    boost::asio::steady_timer output_ready; //reader -> writer, something was queued (or the reader stopped)
+    boost::asio::steady_timer output_drained; //writer -> reader, a write finished (or the writer stopped)
+
+    static ptr create(boost::asio::io_context& io_context, Protocol protocol);
+    ~TcpConnection();
     void start();
 
-    void handle_write(const boost::system::error_code& error, size_t bytes);
-    void handle_read(const boost::system::error_code& error, size_t bytes);
+    boost::asio::awaitable<void> reader();
+    boost::asio::awaitable<void> writer();
+
+    void execute_requests(std::string& responses);
+    int parse_message(std::string& responses);
+    int parse_binary_message(std::string& responses);
 
-    int parse_message();
+    void queue_response(std::string&& response);
+    void recycle(std::string&& buffer);
 
 private:
-    TcpConnection(boost::asio::io_context& io_context);
+    TcpConnection(boost::asio::io_context& io_context, Protocol protocol);
 
 };
 
@@ -0,0 +1,299 @@
+#include "XmlParser.h"
+#include <cstdlib>
+#include <cstring>
+
+const XmlAttribute* find_attribute(const std::vector<XmlAttribute>& attributes, std::string_view name) {
+    for (const XmlAttribute& attribute : attributes) {
+        if (attribute.name == name) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_name_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (unsigned char)c >= 0x80;
+}
+
+static bool is_name_char(char c) {
+    return is_name_start(c) || (c >= '0' && c <= '9') || c == '.' || c == '-';
+}
+
+static const char* skip_space(const char* p, const char* end) {
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static bool starts_with(const char* p, const char* end, const char* prefix) {
+    size_t length = std::strlen(prefix);
+    return size_t(end - p) >= length && std::memcmp(p, prefix, length) == 0;
+}
+
+//position right after the first occurrence of terminator, or nullptr
+static const char* skip_past(const char* p, const char* end, std::string_view terminator) {
+    std::string_view rest(p, end - p);
+    size_t found = rest.find(terminator);
+    return found == std::string_view::npos ? nullptr : p + found + terminator.size();
+}
+
+static std::string_view parse_name(const char*& p, const char* end) {
+    const char* start = p;
+    if (p < end && is_name_start(*p)) {
+        while (p < end && is_name_char(*p)) {
+            p++;
+        }
+    }
+    return std::string_view(start, p - start);
+}
+
+static void append_utf8(std::string& out, unsigned long code) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+//replaces the five predefined entities and &#n; / &#xn; references; anything else is kept as written
+void XmlParser::decode(std::string_view raw, std::string& out) {
+    static const struct {
+        const char* name;
+        char value;
+    } entities[] = {{"lt;", '<'}, {"gt;", '>'}, {"amp;", '&'}, {"quot;", '"'}, {"apos;", '\''}};
+
+    out.clear();
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (raw[i] != '&') {
+            out += raw[i];
+            continue;
+        }
+
+        std::string_view rest = raw.substr(i + 1);
+        size_t semicolon = rest.find(';');
+        if (rest.size() > 1 && rest[0] == '#' && semicolon != std::string_view::npos && semicolon > 1) {
+            bool hex = rest[1] == 'x' || rest[1] == 'X';
+            std::string digits(rest.substr(hex ? 2 : 1, semicolon - (hex ? 2 : 1)));
+            char* digits_end = nullptr;
+            unsigned long code = std::strtoul(digits.c_str(), &digits_end, hex ? 16 : 10);
+            if (!digits.empty() && *digits_end == '\0' && code <= 0x10FFFF) {
+                append_utf8(out, code);
+                i += semicolon + 1;
+                continue;
+            }
+        }
+
+        bool replaced = false;
+        for (const auto& entity : entities) {
+            if (rest.substr(0, std::strlen(entity.name)) == entity.name) {
+                out += entity.value;
+                i += std::strlen(entity.name);
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) {
+            out += '&';
+        }
+    }
+}
+
+bool XmlParser::parse(const char* data, size_t length, XmlHandler& handler) {
+    const char* p = data;
+    const char* end = data + length;
+    open.clear();
+    if (skip_space(p, end) == end) { //nothing but whitespace isn't a document
+        return false;
+    }
+
+    while (p < end) {
+        if (*p != '<') { //character data up to the next tag
+            const char* start = p;
+            const char* next = static_cast<const char*>(std::memchr(p, '<', end - p));
+            p = next != nullptr ? next : end;
+
+            if (!open.empty() && skip_space(start, p) != p) {
+                std::string_view text(start, p - start);
+                if (text.find('&') != std::string_view::npos) {
+                    decode(text, decoded_text);
+                    text = decoded_text;
+                }
+                handler.text(text);
+            }
+            continue;
+        }
+
+        if (starts_with(p, end, "<?")) { //xml declaration or processing instruction
+            p = skip_past(p, end, "?>");
+        } else if (starts_with(p, end, "<!--")) {
+            p = skip_past(p + 4, end, "-->");
+        } else if (starts_with(p, end, "<![CDATA[")) {
+            const char* start = p + 9;
+            p = skip_past(start, end, "]]>");
+            if (p != nullptr && !open.empty() && p - 3 > start) {
+                handler.text(std::string_view(start, p - 3 - start));
+            }
+        } else if (starts_with(p, end, "<!")) { //DOCTYPE and the like
+            p = skip_past(p, end, ">");
+
+        } else if (starts_with(p, end, "</")) {
+            p += 2;
+            std::string_view name = parse_name(p, end);
+            p = skip_space(p, end);
+            if (name.empty() || p == end || *p != '>' || open.empty() || open.back() != name) {
+                return false;
+            }
+            p++;
+            open.pop_back();
+            handler.end_element(name);
+
+        } else { //start tag
+            p++;
+            std::string_view name = parse_name(p, end);
+            if (name.empty()) {
+                return false;
+            }
+
+            attributes.clear();
+            bool self_closing = false;
+            while (true) {
+                const char* before_space = p;
+                p = skip_space(p, end);
+                if (p == end) {
+                    return false;
+                }
+                if (*p == '>') {
+                    p++;
+                    break;
+                }
+                if (*p == '/') {
+                    if (p + 1 == end || p[1] != '>') {
+                        return false;
+                    }
+                    p += 2;
+                    self_closing = true;
+                    break;
+                }
+                if (p == before_space) { //attributes have to be separated by whitespace
+                    return false;
+                }
+
+                std::string_view attribute_name = parse_name(p, end);
+                p = skip_space(p, end);
+                if (attribute_name.empty() || p == end || *p != '=') {
+                    return false;
+                }
+                p = skip_space(p + 1, end);
+                if (p == end || (*p != '"' && *p != '\'')) {
+                    return false;
+                }
+                const char* value_end = static_cast<const char*>(std::memchr(p + 1, *p, end - p - 1));
+                if (value_end == nullptr) {
+                    return false;
+                }
+                attributes.push_back(XmlAttribute{attribute_name, std::string_view(p + 1, value_end - p - 1)});
+                p = value_end + 1;
+            }
+
+            //decoded values live in decoded_values, which isn't resized again until the next tag
+            if (decoded_values.size() < attributes.size()) {
+                decoded_values.resize(attributes.size());
+            }
+            for (size_t i = 0; i < attributes.size(); i++) {
+                if (attributes[i].value.find('&') != std::string_view::npos) {
+                    decode(attributes[i].value, decoded_values[i]);
+                    attributes[i].value = decoded_values[i];
+                }
+            }
+
+            handler.start_element(name, attributes);
+            if (self_closing) {
+                handler.end_element(name);
+            } else {
+                open.push_back(name);
+            }
+        }
+
+        if (p == nullptr) { //unterminated declaration, comment or CDATA
+            return false;
+        }
+    }
+
+    return open.empty();
+}
+
+//appends every callback to the parser's recording. Views into the recorded bytes are kept as they are,
+//anything else (decoded values and text live in the parser's scratch space) is copied
+class XmlParser::Recorder : public XmlHandler {
+public:
+    Recorder(XmlParser& parser, const char* data, size_t length) : parser(parser), data(data), end(data + length) {}
+
+    void start_element(std::string_view name, const std::vector<XmlAttribute>& attributes) override {
+        parser.events.push_back(RecordedEvent{RecordedEvent::START, name, parser.recorded_attributes.size(), attributes.size()});
+        for (const XmlAttribute& attribute : attributes) {
+            parser.recorded_attributes.push_back(XmlAttribute{attribute.name, keep(attribute.value)});
+        }
+    }
+
+    void end_element(std::string_view name) override {
+        parser.events.push_back(RecordedEvent{RecordedEvent::END, name, 0, 0});
+    }
+
+    void text(std::string_view text) override {
+        parser.events.push_back(RecordedEvent{RecordedEvent::TEXT, keep(text), 0, 0});
+    }
+
+private:
+    XmlParser& parser;
+    const char* data;
+    const char* end;
+
+    std::string_view keep(std::string_view view) {
+        if (view.data() >= data && view.data() + view.size() <= end) {
+            return view;
+        }
+        parser.copies.emplace_back(view);
+        return parser.copies.back();
+    }
+};
+
+bool XmlParser::record(const char* data, size_t length) {
+    events.clear();
+    recorded_attributes.clear();
+    copies.clear();
+    Recorder recorder(*this, data, length);
+    if (!parse(data, length, recorder)) {
+        events.clear();
+        return false;
+    }
+    return true;
+}
+
+void XmlParser::replay(XmlHandler& handler) {
+    for (const RecordedEvent& event : events) {
+        if (event.type == RecordedEvent::START) {
+            auto first = recorded_attributes.begin() + event.first_attribute;
+            replayed_attributes.assign(first, first + event.attribute_count);
+            handler.start_element(event.name, replayed_attributes);
+        } else if (event.type == RecordedEvent::END) {
+            handler.end_element(event.name);
+        } else {
+            handler.text(event.name);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef XMLPARSER_H
+#define XMLPARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//one attribute of a start tag. Views point into the parsed bytes, or into the parser's scratch space for
+//values that had entity references, and are only valid during the callback
+struct XmlAttribute {
+    std::string_view name;
+    std::string_view value;
+};
+
+//callbacks of XmlParser, in document order. The defaults do nothing, so a plain XmlHandler just checks
+//that a document is well formed
+class XmlHandler {
+public:
+    virtual ~XmlHandler() {}
+
+    virtual void start_element(std::string_view /*name*/, const std::vector<XmlAttribute>& /*attributes*/) {}
+    virtual void end_element(std::string_view /*name*/) {}
+
+    //character data inside an element with entities decoded; whitespace-only runs are not reported
+    virtual void text(std::string_view /*text*/) {}
+};
+
+//first attribute called name, or nullptr
+const XmlAttribute* find_attribute(const std::vector<XmlAttribute>& attributes, std::string_view name);
+
+//streaming parser for the small XML subset requests use: elements, attributes, text, entity and character
+//references, CDATA; declarations, comments and DOCTYPE are skipped. No tree is built and the input is not
+//copied. One parser per connection, so its scratch buffers are reused across requests
+class XmlParser {
+public:
+    //false if the document is malformed (unbalanced tags, bad syntax) or empty. A document without any element
+    //is fine, the handler just sees nothing. Callbacks made before the error was found are not undone, so
+    //record and replay when that matters
+    bool parse(const char* data, size_t length, XmlHandler& handler);
+
+    //parses like parse(), but only records the callbacks; false, with nothing recorded, if the document is
+    //malformed. One pass over the bytes, so nothing has to run before a document is known to be well formed
+    bool record(const char* data, size_t length);
+
+    //makes the callbacks the last record() recorded, as parse() would have; can be repeated. Views point into
+    //the recorded bytes, which have to outlive it, or into the parser's copies of decoded values and text
+    void replay(XmlHandler& handler);
+
+private:
+    struct RecordedEvent {
+        enum Type : uint8_t { START, END, TEXT } type;
+        std::string_view name; //or the text
+        size_t first_attribute; //in recorded_attributes, for START
+        size_t attribute_count;
+    };
+    class Recorder;
+
+    std::vector<XmlAttribute> attributes;
+    std::vector<std::string> decoded_values; //attribute values with entity references, by attribute index
+    std::vector<std::string_view> open; //names of the elements enclosing the current position
+    std::string decoded_text;
+    std::vector<RecordedEvent> events;
+    std::vector<XmlAttribute> recorded_attributes;
+    std::vector<XmlAttribute> replayed_attributes; //one element's, as start_element takes them
+    std::deque<std::string> copies; //decoded values and text, which the next tag or text overwrites
+
+    static void decode(std::string_view raw, std::string& out);
+};
+
+#endif
@@ -1,13 +1,26 @@
 //entry point
 #include "MatchingEngineServer.h"
 #include <exception>
+#include <functional>
+#include <stdexcept>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 #include <boost/asio.hpp>
+#include "DatabaseTelemetry.h"
 #include "DatabaseTransactions.h"
+#include "DatabaseWorkers.h"
+#include "GroupCommit.h"
+#include "MatchingEngine.h"
+#include "MetricsServer.h"
+#include "Journal.h"
+#include "LatencyStats.h"
+#include "PersistenceWriter.h"
+#include "Snapshot.h"
+#include "Config.h"
 
-#define THREAD_POOL_SIZE 8
+#define MATCHING_SHARDS 4 //threads that own the order books
 #define SERVER_PORT 12345
 
 
@@ -17,46 +30,115 @@ int main() {
     std::cout << "PID: " << getpid() << std::endl;
 
     try {
-        boost::asio::io_context io_context;
+        Config::load();
 
-        //create pool of db connection pointers, retrying for each connection if needed
-        std::vector<std::shared_ptr<pqxx::connection>> connection_pool;
-        for (int i = 0; i < THREAD_POOL_SIZE; ++i) {
-            connection_pool.push_back([](){
-                int connection_attempt = 0;
-                while (connection_attempt < 11) {
-                    try {
-                        return std::make_shared<pqxx::connection>(
-                            "dbname=postgres user=postgres password=postgres host=db port=5432");
-                    } catch (const std::exception& e) {
-                        connection_attempt++;
-                        if (connection_attempt == 10) {
-                            throw;
-                        }
-                        std::this_thread::sleep_for(std::chrono::seconds(1)); //1 second sleep of thread
+        //connect, retrying if needed
+        auto connect = [](){
+            int connection_attempt = 0;
+            while (connection_attempt < 11) {
+                try {
+                    return std::make_shared<pqxx::connection>(
+                        "dbname=postgres user=postgres password=postgres host=db port=5432");
+                } catch (const std::exception& e) {
+                    connection_attempt++;
+                    if (connection_attempt == 10) {
+                        throw;
                     }
+                    std::this_thread::sleep_for(std::chrono::seconds(1)); //1 second sleep of thread
                 }
-                return std::shared_ptr<pqxx::connection>(nullptr); // just in case (unreachable)
-            }()); //add () to call the lambda
+            }
+            return std::shared_ptr<pqxx::connection>(nullptr); // just in case (unreachable)
+        };
+
+        //MEMORY backend: the write-behind writer is the only thread that talks to postgres, so one connection.
+        //DATABASE backend: every database worker runs requests on its own connection
+        std::vector<std::shared_ptr<pqxx::connection>> connection_pool;
+        int connections = Config::backend == Config::DATABASE ? Config::db_workers : 1;
+        for (int i = 0; i < connections; ++i) {
+            connection_pool.push_back(connect());
         }
 
-        //main thread gets 0th connection, resets db
+        //main thread uses the first for setup and recovery
         thread_conn = connection_pool[0];
-        DatabaseTransactions::setup();
+        if (!Config::journal_path.empty()) {
+            Journal::open(Config::journal_path);
+        }
+        //without a journal there is nothing to recover, reset db
+        DatabaseTransactions::setup(Config::backend == Config::DATABASE || !Journal::enabled());
+        for (std::shared_ptr<pqxx::connection>& conn : connection_pool) {
+            DatabaseTransactions::prepare(*conn);
+        }
+
+        if (Config::backend == Config::MEMORY) {
+            MatchingEngine::start(MATCHING_SHARDS);
+            uint64_t persisted_seq = DatabaseTransactions::persisted_seq();
+            if (Journal::enabled()) {
+                MatchingEngine::recover(persisted_seq);
+                if (Journal::last_seq() < persisted_seq) {
+                    throw std::runtime_error("postgres has events the journal doesn't, refusing to start on a stale journal");
+                }
+            }
+            PersistenceWriter::start(connection_pool[0], persisted_seq);
+            Journal::start();
+            Snapshot::start();
+        }
+        if (Config::backend == Config::DATABASE) {
+            if (GroupCommit::enabled()) { //workers hand their calls to the committer, which has its own connection
+                std::shared_ptr<pqxx::connection> committer = connect();
+                DatabaseTransactions::prepare(*committer);
+                GroupCommit::start(committer);
+            }
+            DatabaseWorkers::start(Config::db_workers, connection_pool);
+            DatabaseTelemetry::start(Config::lock_sample_ms > 0 ? connect() : nullptr); //the sampler's own connection
+        } else {
+            DatabaseWorkers::start(Config::db_workers, {}); //requests wait on the shards and durability, not postgres
+        }
+
+        //shared: every io thread runs the one io_context, and handlers of a connection run on any of them.
+        //per thread: each io thread has its own io_context and acceptors, bound with SO_REUSEPORT so the kernel
+        //spreads connections over them, and a connection stays on the thread that accepted it
+        int io_context_count = Config::io_per_thread ? Config::io_threads : 1;
+        std::vector<std::unique_ptr<boost::asio::io_context>> io_contexts;
+        std::vector<std::unique_ptr<MatchingEngineServer>> servers;
+        for (int i = 0; i < io_context_count; i++) {
+            //a concurrency hint of 1 lets asio skip locking its queue when only one thread runs it
+            io_contexts.emplace_back(Config::io_per_thread ? new boost::asio::io_context(1) : new boost::asio::io_context());
+            boost::asio::io_context& io_context = *io_contexts.back();
+
+            //constructor will call start_accept and set up async tasks/work
+            servers.emplace_back(new MatchingEngineServer(io_context, SERVER_PORT, TcpConnection::XML, Config::io_per_thread));
+            if (Config::binary_port != 0) { //same io threads and engine, binary protocol
+                servers.emplace_back(new MatchingEngineServer(io_context, Config::binary_port, TcpConnection::BINARY, Config::io_per_thread));
+            }
+        }
+
+        std::unique_ptr<MetricsServer> metrics;
+        if (Config::metrics_port != 0) { //on the first io_context, a scrape is a short task between requests
+            metrics.reset(new MetricsServer(*io_contexts[0], Config::metrics_port));
+        }
 
-        MatchingEngineServer server(io_context, SERVER_PORT); //constructor will call start_accept and set up async tasks/work
+        //kill -USR1 <pid> prints the latency histograms of every stage
+        boost::asio::signal_set stats_signal(*io_contexts[0], SIGUSR1);
+        std::function<void()> wait_for_stats_signal = [&]() {
+            stats_signal.async_wait([&](const boost::system::error_code& error, int) {
+                if (!error) {
+                    std::cout << LatencyStats::report() << DatabaseTelemetry::report() << std::flush;
+                    wait_for_stats_signal();
+                }
+            });
+        };
+        wait_for_stats_signal();
 
         //thread pool
         std::vector<std::thread> threads;
-        for (int i = 1; i < THREAD_POOL_SIZE; i++) {
+        for (int i = 1; i < Config::io_threads; i++) {
             threads.emplace_back([&, i]{ //must explicitly capture i by value (thread might start executing this lambda after i changes)
-                thread_conn = connection_pool[i]; //setting the thread local db connection variable (top of file)
-                io_context.run(); 
+                io_contexts[i % io_context_count]->run();
             });
         }
 
         //main thread
-        io_context.run(); 
+        io_contexts[0]->run();
 
         //if a thread has an exception during io_context.run(), should handle it inside so we don't go to this
         //exception handler. For example, just make thread drop the excepting task.
@@ -67,6 +149,13 @@ int main() {
                 a.join();
             }
         }
+        DatabaseWorkers::stop();
+        GroupCommit::stop();
+        DatabaseTelemetry::stop();
+        Snapshot::stop();
+        MatchingEngine::stop();
+        Journal::stop();
+        PersistenceWriter::stop();
 
     } catch (const std::exception& e) {
         std::cout << "Exception caught: " << e.what() << std::endl << "Shutting down server..." << std::endl;
@@ -0,0 +1,413 @@
+//microbenchmarks of the engine's hot paths, with no postgres or sockets involved: request frames split and
+//parsed as in TcpConnection::parse_message, responses written with ResponseWriter, and OrderBook insert,
+//match, cancel and multi-level sweeps on synthetic books of 1k to 1M resting orders. Every case is timed
+//--repeat times; one JSON line per case goes to stdout. Given --baseline (an earlier run's output) it exits
+//with 1 when a case's median got slower than the baseline by more than --tolerance.
+//build: make bench (in docker-deploy/src/matching-engine), or
+//       g++ -O3 -std=c++20 -I../docker-deploy/src/matching-engine -o engineBench engineBench.cpp ../docker-deploy/src/matching-engine/{XmlParser,ResponseWriter,OrderBook,Price}.cpp
+//run:   ./engineBench > before.json; ...; ./engineBench --baseline=before.json
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "Price.h"
+#include "ResponseWriter.h"
+#include "XmlParser.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define PIPELINED_FRAMES 64 //requests per read when parsing
+#define BOOK_LEVELS 1000 //price levels per side of a synthetic book
+#define RESTING_SHARES 100 //every synthetic resting order, so a 100 share order fills exactly one
+#define SWEEP_ORDERS 64 //resting orders one sweeping order fills
+
+struct Options {
+    int repeat = 5;
+    double min_ms = 20; //each repeat runs its case for at least this long
+    int max_book = 1000000;
+    std::string filter; //only cases whose name contains this
+    std::string baseline;
+    double tolerance = 0.10;
+};
+
+struct Result {
+    std::string name;
+    int book; //resting orders, 0 for cases without a book
+    double median_ns; //per operation
+    double min_ns;
+};
+
+static Options options;
+static std::vector<Result> results;
+
+//stops the compiler from dropping work whose result is unused
+static void keep(const void* value) {
+    asm volatile("" : : "g"(value) : "memory");
+}
+
+//runs run (ops operations) until min_ms of it has been timed, calling the untimed restore after every run.
+//Repeated, the median and fastest ns per operation are recorded
+static void measure(const std::string& name, int book, int ops, const std::function<void()>& run, const std::function<void()>& restore) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    std::vector<double> per_op;
+    for (int repeat = 0; repeat < options.repeat; repeat++) {
+        Clock::duration timed = Clock::duration::zero();
+        uint64_t done = 0;
+        while (timed < std::chrono::duration<double, std::milli>(options.min_ms)) {
+            Clock::time_point start = Clock::now();
+            run();
+            timed += Clock::now() - start;
+            done += ops;
+            restore();
+        }
+        per_op.push_back(std::chrono::duration<double, std::nano>(timed).count() / done);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    Result result{name, book, per_op[per_op.size() / 2], per_op.front()};
+    results.push_back(result);
+    printf("{\"bench\":\"%s\",\"book\":%d,\"median_ns\":%.2f,\"min_ns\":%.2f,\"repeat\":%d}\n",
+           result.name.c_str(), result.book, result.median_ns, result.min_ns, options.repeat);
+    fflush(stdout);
+}
+
+//what RequestHandler takes from each element: numbers converted, limits and balances parsed as prices
+class DecodeHandler : public XmlHandler {
+public:
+    int64_t checksum = 0;
+
+    void start_element(std::string_view name, const std::vector<XmlAttribute>& attributes) override {
+        for (const XmlAttribute& attribute : attributes) {
+            if (attribute.name == "limit" || attribute.name == "balance") {
+                storage.assign(attribute.value);
+                price_t value;
+                if (Price::parse(storage.c_str(), value)) {
+                    checksum += value;
+                }
+            } else if (attribute.name != "sym") {
+                int64_t value = 0;
+                std::from_chars(attribute.value.data(), attribute.value.data() + attribute.value.size(), value);
+                checksum += value;
+            }
+        }
+        checksum += name.size();
+    }
+
+    void text(std::string_view text) override {
+        int64_t value = 0;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        checksum += value;
+    }
+
+private:
+    std::string storage;
+};
+
+static std::string frame(const std::string& xml) {
+    return std::to_string(xml.size()) + "\n" + xml;
+}
+
+//"<length>\n<xml>" frames back to back, each recorded and then replayed to decode it, the way
+//parse_message does; returns the frames handled
+static int parse_frames(const std::string& input, XmlParser& parser, DecodeHandler& decode) {
+    size_t offset = 0;
+    int frames = 0;
+    while (offset < input.size()) {
+        const char* data = input.data() + offset;
+        size_t length_digits = 0;
+        size_t xml_len = 0;
+        while (data[length_digits] >= '0' && data[length_digits] <= '9') {
+            xml_len = xml_len * 10 + (data[length_digits] - '0');
+            length_digits++;
+        }
+        const char* xml = data + length_digits + 1;
+
+        if (parser.record(xml, xml_len)) {
+            parser.replay(decode);
+        }
+        offset += length_digits + 1 + xml_len;
+        frames++;
+    }
+    return frames;
+}
+
+static void parse_benchmarks() {
+    std::string create = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<create>\n  <account id=\"12\" balance=\"500000\"/>\n";
+    for (const char* stock : {"AAPL", "GOOG", "NVDA", "AMZN"}) {
+        create += "  <symbol sym=\"" + std::string(stock) + "\">\n    <account id=\"12\">1000</account>\n  </symbol>\n";
+    }
+    create += "</create>\n";
+
+    std::vector<std::pair<std::string, std::string>> shapes = {
+        {"parse_order", "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<transactions id=\"12\">\n"
+                        "  <order sym=\"AAPL\" amount=\"-40\" limit=\"125.25\"/>\n</transactions>\n"},
+        {"parse_query", "<transactions id=\"12\"><query id=\"1043\"/></transactions>"},
+        {"parse_cancel", "<transactions id=\"12\"><cancel id=\"1043\"/></transactions>"},
+        {"parse_create", create},
+    };
+
+    XmlParser parser;
+    DecodeHandler decode;
+    for (const auto& shape : shapes) {
+        std::string input;
+        for (int i = 0; i < PIPELINED_FRAMES; i++) {
+            input += frame(shape.second);
+        }
+        measure(shape.first, 0, PIPELINED_FRAMES, [&]() { parse_frames(input, parser, decode); }, []() {});
+    }
+    keep(&decode.checksum);
+}
+
+static void serialize_benchmarks() {
+    std::string out;
+    out.reserve(1 << 20);
+
+    measure("serialize_opened", 0, PIPELINED_FRAMES, [&]() {
+        for (int i = 0; i < PIPELINED_FRAMES; i++) {
+            ResponseWriter response(out);
+            response.open("opened");
+            response.attribute("sym", "AAPL");
+            response.attribute("amount", int64_t(-40));
+            response.price_attribute("limit", 1252500);
+            response.attribute("id", int64_t(1043 + i));
+            response.close();
+            response.finish();
+        }
+        keep(out.data());
+    }, [&]() { out.clear(); });
+
+    //a query answer: open remainder, one cancel and a few executions
+    measure("serialize_status", 0, PIPELINED_FRAMES, [&]() {
+        for (int i = 0; i < PIPELINED_FRAMES; i++) {
+            ResponseWriter response(out);
+            response.open("status");
+            response.attribute("id", int64_t(1043 + i));
+            response.open("open");
+            response.attribute("shares", int64_t(10));
+            response.close();
+            for (int execution = 0; execution < 3; execution++) {
+                response.open("executed");
+                response.attribute("shares", int64_t(10));
+                response.price_attribute("price", 1250000 + execution * 2500);
+                response.attribute("time", int64_t(1760000000 + execution));
+                response.close();
+            }
+            response.close();
+            response.finish();
+        }
+        keep(out.data());
+    }, [&]() { out.clear(); });
+
+    measure("serialize_error", 0, PIPELINED_FRAMES, [&]() {
+        for (int i = 0; i < PIPELINED_FRAMES; i++) {
+            ResponseWriter response(out);
+            response.open("error");
+            response.attribute("sym", "A&B");
+            response.attribute("id", int64_t(12));
+            response.text("Insufficient funds <balance> to place order.");
+            response.close();
+            response.finish();
+        }
+        keep(out.data());
+    }, [&]() { out.clear(); });
+}
+
+//a book of resting orders of RESTING_SHARES each: bids on the BOOK_LEVELS ticks below 100, asks on the ones
+//above, at random levels so levels fill in price order as often as not
+class SyntheticBook {
+public:
+    OrderBook book;
+    std::map<int, price_t> resting; //order id -> limit, signed by side (negative: sell)
+    int next_id = 1;
+    std::mt19937_64 random{42};
+
+    static constexpr price_t MID = 100 * Price::SCALE;
+
+    explicit SyntheticBook(int size) {
+        for (int i = 0; i < size; i++) {
+            add_resting(i % 2 == 0);
+        }
+    }
+
+    price_t random_level(bool buy) {
+        price_t ticks = std::uniform_int_distribution<price_t>(1, BOOK_LEVELS)(random);
+        return buy ? MID - ticks : MID + ticks;
+    }
+
+    int add_resting(bool buy) {
+        return add_resting(buy, random_level(buy));
+    }
+
+    int add_resting(bool buy, price_t limit) {
+        int id = next_id++;
+        book.rest_order(id, 1, buy ? RESTING_SHARES : -RESTING_SHARES, limit);
+        resting[id] = buy ? limit : -limit;
+        return id;
+    }
+
+    //rests a new order in place of every resting one the fills used up, at the same price
+    void replace_filled(const std::vector<Fill>& fills, bool incoming_is_buy) {
+        for (const Fill& fill : fills) {
+            int consumed = incoming_is_buy ? fill.sell_order_id : fill.buy_order_id;
+            resting.erase(consumed);
+            add_resting(!incoming_is_buy, fill.price);
+        }
+    }
+};
+
+static void book_benchmarks(int size) {
+    SyntheticBook synthetic(size);
+    int ops = std::max(1, std::min(size / 4, 10000)); //never takes more than half a side
+    std::vector<int> ids;
+    ids.reserve(ops);
+    std::vector<std::vector<Fill>> fills(ops);
+    std::vector<Fill> all_fills;
+
+    //orders that don't cross, resting on existing levels; removed again untimed
+    std::vector<price_t> limits(ops);
+    for (int i = 0; i < ops; i++) {
+        limits[i] = synthetic.random_level(i % 2 == 0);
+    }
+    measure("book_insert", size, ops, [&]() {
+        for (int i = 0; i < ops; i++) {
+            int id = synthetic.next_id++;
+            fills[i] = synthetic.book.add_order(id, 2, i % 2 == 0 ? RESTING_SHARES : -RESTING_SHARES, limits[i]);
+            ids.push_back(id);
+        }
+    }, [&]() {
+        for (int id : ids) {
+            synthetic.book.cancel_order(id);
+        }
+        ids.clear();
+    });
+
+    //marketable orders each filling the best resting order of the other side, buys and sells alternating;
+    //what they took is rested again untimed
+    measure("book_match", size, ops, [&]() {
+        for (int i = 0; i < ops; i++) {
+            bool buy = i % 2 == 0;
+            price_t limit = buy ? SyntheticBook::MID + BOOK_LEVELS : SyntheticBook::MID - BOOK_LEVELS;
+            fills[i] = synthetic.book.add_order(synthetic.next_id++, 2, buy ? RESTING_SHARES : -RESTING_SHARES, limit);
+        }
+    }, [&]() {
+        for (int i = 0; i < ops; i++) {
+            synthetic.replace_filled(fills[i], i % 2 == 0);
+        }
+    });
+
+    //one order walking the ask side level by level, in price order, until SWEEP_ORDERS resting orders filled
+    int sweeps = std::max(1, std::min(ops / SWEEP_ORDERS, 100));
+    measure("book_sweep64", size, sweeps, [&]() {
+        for (int i = 0; i < sweeps; i++) {
+            fills[i] = synthetic.book.add_order(synthetic.next_id++, 2, SWEEP_ORDERS * RESTING_SHARES, SyntheticBook::MID + BOOK_LEVELS);
+        }
+    }, [&]() {
+        for (int i = 0; i < sweeps; i++) {
+            synthetic.replace_filled(fills[i], true);
+        }
+    });
+
+    //random resting orders from anywhere in the book; rested again untimed, at the back of their level
+    std::vector<int> resting_ids;
+    resting_ids.reserve(synthetic.resting.size());
+    for (const auto& order : synthetic.resting) {
+        resting_ids.push_back(order.first);
+    }
+    std::shuffle(resting_ids.begin(), resting_ids.end(), synthetic.random);
+    resting_ids.resize(ops);
+    measure("book_cancel", size, ops, [&]() {
+        for (int id : resting_ids) {
+            bool canceled = synthetic.book.cancel_order(id);
+            keep(&canceled);
+        }
+    }, [&]() {
+        for (int& id : resting_ids) {
+            price_t limit = synthetic.resting[id];
+            synthetic.resting.erase(id);
+            id = synthetic.add_resting(limit > 0, limit > 0 ? limit : -limit);
+        }
+    });
+}
+
+//median_ns of every case in an earlier run's output
+static std::map<std::pair<std::string, int>, double> read_baseline(const std::string& path) {
+    std::map<std::pair<std::string, int>, double> baseline;
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "can't read baseline " << path << std::endl;
+        exit(2);
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        char name[128];
+        int book;
+        double median;
+        if (sscanf(line.c_str(), "{\"bench\":\"%127[^\"]\",\"book\":%d,\"median_ns\":%lf", name, &book, &median) == 3) {
+            baseline[{name, book}] = median;
+        }
+    }
+    return baseline;
+}
+
+static void usage() {
+    std::cerr << "usage: ./engineBench [--repeat=5] [--min-ms=20] [--max-book=1000000] [--filter=book_]\n"
+                 "                     [--baseline=earlier.json] [--tolerance=0.10]" << std::endl;
+    exit(2);
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+            usage();
+        }
+        std::string name = arg.substr(2, equals - 2);
+        std::string value = arg.substr(equals + 1);
+
+        if (name == "repeat") options.repeat = std::max(1, std::stoi(value));
+        else if (name == "min-ms") options.min_ms = std::stod(value);
+        else if (name == "max-book") options.max_book = std::stoi(value);
+        else if (name == "filter") options.filter = value;
+        else if (name == "baseline") options.baseline = value;
+        else if (name == "tolerance") options.tolerance = std::stod(value);
+        else usage();
+    }
+
+    parse_benchmarks();
+    serialize_benchmarks();
+    for (int size = 1000; size <= options.max_book; size *= 10) {
+        book_benchmarks(size);
+    }
+
+    if (options.baseline.empty()) {
+        return EXIT_SUCCESS;
+    }
+    std::map<std::pair<std::string, int>, double> baseline = read_baseline(options.baseline);
+    bool regressed = false;
+    for (const Result& result : results) {
+        auto found = baseline.find({result.name, result.book});
+        if (found == baseline.end()) {
+            continue;
+        }
+        double change = result.median_ns / found->second - 1;
+        if (change > options.tolerance) {
+            regressed = true;
+            std::cerr << "REGRESSION " << result.name << " book=" << result.book << ": " << found->second << " -> "
+                      << result.median_ns << " ns/op (" << (change >= 0 ? "+" : "") << int(change * 100) << "%)" << std::endl;
+        }
+    }
+    std::cerr << (regressed ? "slower than the baseline" : "no regressions against the baseline") << std::endl;
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
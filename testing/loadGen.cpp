@@ -0,0 +1,511 @@
+//open loop load generator for the XML port. Every connection has its own send schedule at the target rate
+//and pipelines requests on it whether or not earlier responses came back, so a stalled engine can't slow
+//the generator down and hide its own latency (coordinated omission): each latency is measured from when
+//the request was due to be sent, not from when it was sent. --rate=0 runs closed loop instead, one request
+//in flight per connection.
+//build: g++ -O2 -std=c++17 -pthread -o loadGen loadGen.cpp
+//run:   ./loadGen --connections=64 --threads=4 --rate=20000 --duration=30 --mix=5:65:20:10 --zipf=1.1
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+enum RequestType { CREATE, ORDER, QUERY, CANCEL, TYPE_COUNT };
+static const char* TYPE_NAMES[] = {"create", "order", "query", "cancel"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 12345;
+    int connections = 16;
+    int threads = 4;
+    double rate = 1000; //requests per second over all connections, 0: closed loop
+    double duration = 10; //seconds measured
+    double warmup = 2; //seconds run before measuring
+    int mix[TYPE_COUNT] = {5, 65, 20, 10}; //create:order:query:cancel weights
+    int symbols = 100;
+    double zipf = 1.0; //symbol skew exponent, 0 for uniform
+    int price = 100; //middle of the price band
+    int spread = 5; //buys and sells are both drawn from price +- spread, so they cross
+    int max_shares = 100;
+    unsigned seed = 1;
+};
+
+//log-linear histogram of microseconds, 1/64 relative precision, like the engine's LatencyStats
+class Histogram {
+public:
+    static const int SUB = 64;
+    static const int MAGNITUDES = 40;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(SUB * MAGNITUDES);
+    uint64_t total = 0;
+    double max = 0;
+
+    void record(double us) {
+        uint64_t value = uint64_t(std::max(0.0, us) * 16); //1/16 us resolution at the bottom
+        int bucket;
+        if (value < SUB) {
+            bucket = int(value);
+        } else {
+            int magnitude = 63 - __builtin_clzll(value); //>= 6
+            int sub = int(value >> (magnitude - 6)) - SUB;
+            bucket = std::min(SUB * MAGNITUDES - 1, SUB + (magnitude - 6) * SUB + sub);
+        }
+        counts[bucket]++;
+        total++;
+        max = std::max(max, us);
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    //upper edge of the bucket holding the given fraction of values, in us
+    double percentile(double fraction) const {
+        uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(fraction * total)));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank) {
+                return std::min(max, upper(bucket) / 16.0);
+            }
+        }
+        return max;
+    }
+
+private:
+    static double upper(size_t bucket) {
+        if (bucket < SUB) {
+            return bucket + 1;
+        }
+        int magnitude = int(bucket - SUB) / SUB + 6;
+        uint64_t sub = (bucket - SUB) % SUB;
+        uint64_t width = uint64_t(1) << (magnitude - 6);
+        return double((SUB + sub + 1) * width);
+    }
+};
+
+//draws symbol indexes with probability proportional to 1 / (rank + 1)^s
+class Zipf {
+public:
+    Zipf(int count, double exponent) : cdf(count) {
+        double sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += 1.0 / std::pow(i + 1, exponent);
+            cdf[i] = sum;
+        }
+        for (double& value : cdf) {
+            value /= sum;
+        }
+    }
+
+    int operator()(std::mt19937_64& random) const {
+        double u = std::uniform_real_distribution<double>(0, 1)(random);
+        return std::min(int(cdf.size()) - 1, int(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()));
+    }
+
+private:
+    std::vector<double> cdf;
+};
+
+struct Pending {
+    Clock::time_point due; //when the schedule said to send it
+    RequestType type;
+};
+
+struct Connection {
+    int fd = -1;
+    uint32_t account = 0;
+    std::string out; //bytes not written yet
+    std::string in; //bytes not parsed yet
+    std::deque<Pending> pending; //sent, in order; responses come back in the same order
+    std::vector<std::string> order_ids; //recently opened orders, for queries and cancels
+    Clock::time_point next_due;
+};
+
+struct ThreadResult {
+    Histogram all;
+    Histogram by_type[TYPE_COUNT];
+    uint64_t errors = 0;
+    uint64_t sent = 0;
+    uint64_t backlog_max = 0; //most requests ever outstanding on one connection
+};
+
+static Options options;
+static std::vector<std::string> symbol_names;
+static std::atomic<uint32_t> next_account(0);
+
+static std::string frame(const std::string& xml) {
+    return std::to_string(xml.size()) + "\n" + xml;
+}
+
+static std::string create_request(uint32_t account) {
+    std::string xml = "<create><account id=\"" + std::to_string(account) + "\" balance=\"1000000000\"/>";
+    for (const std::string& symbol : symbol_names) {
+        xml += "<symbol sym=\"" + symbol + "\"><account id=\"" + std::to_string(account) + "\">1000000</account></symbol>";
+    }
+    return xml + "</create>";
+}
+
+static int connect_to_engine() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+//blocking request/response, for the setup before the measured run
+static std::string round_trip(int fd, const std::string& xml) {
+    std::string message = frame(xml);
+    if (send(fd, message.data(), message.size(), 0) != ssize_t(message.size())) {
+        perror("send");
+        exit(1);
+    }
+    std::string in;
+    char buffer[65536];
+    while (true) {
+        size_t newline = in.find('\n');
+        if (newline != std::string::npos && in.size() >= newline + 1 + std::stoul(in.substr(0, newline))) {
+            return in.substr(newline + 1);
+        }
+        ssize_t bytes = read(fd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            std::cout << "engine closed the connection during setup" << std::endl;
+            exit(1);
+        }
+        in.append(buffer, bytes);
+    }
+}
+
+static RequestType pick_type(std::mt19937_64& random) {
+    int total = 0;
+    for (int weight : options.mix) {
+        total += weight;
+    }
+    int pick = std::uniform_int_distribution<int>(0, total - 1)(random);
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        if (pick < options.mix[type]) {
+            return RequestType(type);
+        }
+        pick -= options.mix[type];
+    }
+    return ORDER;
+}
+
+static std::string make_request(Connection& connection, RequestType& type, std::mt19937_64& random, const Zipf& zipf) {
+    if ((type == QUERY || type == CANCEL) && connection.order_ids.empty()) {
+        type = ORDER; //nothing to look at yet
+    }
+    std::string account = std::to_string(connection.account);
+
+    if (type == CREATE) {
+        uint32_t id = next_account++;
+        const std::string& symbol = symbol_names[zipf(random)];
+        return "<create><account id=\"" + std::to_string(id) + "\" balance=\"100000\"/><symbol sym=\"" + symbol +
+               "\"><account id=\"" + std::to_string(id) + "\">100</account></symbol></create>";
+    }
+
+    if (type == ORDER) {
+        const std::string& symbol = symbol_names[zipf(random)];
+        int shares = std::uniform_int_distribution<int>(1, options.max_shares)(random);
+        if (random() & 1) {
+            shares = -shares;
+        }
+        int limit = options.price + std::uniform_int_distribution<int>(-options.spread, options.spread)(random);
+        return "<transactions id=\"" + account + "\"><order sym=\"" + symbol + "\" amount=\"" + std::to_string(shares) +
+               "\" limit=\"" + std::to_string(limit) + "\"/></transactions>";
+    }
+
+    size_t pick = std::uniform_int_distribution<size_t>(0, connection.order_ids.size() - 1)(random);
+    std::string id = connection.order_ids[pick];
+    if (type == CANCEL) { //canceled once, then only queried
+        connection.order_ids[pick] = connection.order_ids.back();
+        connection.order_ids.pop_back();
+    }
+    return "<transactions id=\"" + account + "\"><" + std::string(type == QUERY ? "query" : "cancel") + " id=\"" + id +
+           "\"/></transactions>";
+}
+
+//takes every complete response off the front of in, recording each against the request it answers
+static void take_responses(Connection& connection, Clock::time_point now, Clock::time_point measure_from, ThreadResult& result) {
+    size_t parsed = 0;
+    while (true) {
+        size_t newline = connection.in.find('\n', parsed);
+        if (newline == std::string::npos) {
+            break;
+        }
+        size_t length = std::strtoul(connection.in.c_str() + parsed, nullptr, 10);
+        if (connection.in.size() < newline + 1 + length) {
+            break;
+        }
+        const char* xml = connection.in.data() + newline + 1;
+        std::string_view response(xml, length);
+        parsed = newline + 1 + length;
+
+        if (connection.pending.empty()) {
+            std::cout << "response without a request" << std::endl;
+            exit(1);
+        }
+        Pending request = connection.pending.front();
+        connection.pending.pop_front();
+
+        if (request.type == ORDER) { //remember what opened, for later queries and cancels
+            size_t id = response.find(" id=\"");
+            if (response.find("<opened") != std::string_view::npos && id != std::string_view::npos) {
+                size_t end = response.find('"', id + 5);
+                connection.order_ids.emplace_back(response.substr(id + 5, end - id - 5));
+                if (connection.order_ids.size() > 1000) {
+                    connection.order_ids.erase(connection.order_ids.begin());
+                }
+            }
+        }
+
+        if (request.due >= measure_from) {
+            double us = std::chrono::duration<double, std::micro>(now - request.due).count();
+            result.all.record(us);
+            result.by_type[request.type].record(us);
+            if (response.find("<error") != std::string_view::npos) {
+                result.errors++;
+            }
+        }
+    }
+    connection.in.erase(0, parsed);
+}
+
+static void run_thread(std::vector<Connection>& connections, Clock::time_point start, ThreadResult& result, unsigned seed) {
+    std::mt19937_64 random(seed);
+    Zipf zipf(options.symbols, options.zipf);
+    Clock::time_point measure_from = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+    Clock::time_point stop_sending = measure_from + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    Clock::duration interval = options.rate > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.connections / options.rate))
+        : Clock::duration::zero();
+
+    //spread the connections' schedules over one interval so they don't all send at once
+    for (size_t i = 0; i < connections.size(); i++) {
+        connections[i].next_due = start + interval * (i + 1) / (connections.size() + 1);
+        fcntl(connections[i].fd, F_SETFL, O_NONBLOCK);
+    }
+
+    std::vector<pollfd> polls(connections.size());
+    char buffer[65536];
+    while (true) {
+        Clock::time_point now = Clock::now();
+        bool sending = now < stop_sending;
+        bool outstanding = false;
+        Clock::time_point wake = now + std::chrono::milliseconds(10);
+
+        for (size_t i = 0; i < connections.size(); i++) {
+            Connection& connection = connections[i];
+            //open loop: everything due is sent now, however many responses are still missing.
+            //closed loop: the next request is due once the previous one is answered
+            while (sending && connection.next_due <= now && (interval > Clock::duration::zero() || connection.pending.empty())) {
+                RequestType type = pick_type(random);
+                std::string xml = make_request(connection, type, random, zipf);
+                Clock::time_point due = interval > Clock::duration::zero() ? connection.next_due : now;
+                connection.out += frame(xml);
+                connection.pending.push_back(Pending{due, type});
+                connection.next_due += interval;
+                result.sent++;
+                result.backlog_max = std::max<uint64_t>(result.backlog_max, connection.pending.size());
+            }
+            if (interval > Clock::duration::zero()) {
+                wake = std::min(wake, connection.next_due);
+            } else if (connection.pending.empty()) {
+                connection.next_due = now;
+            }
+            outstanding = outstanding || !connection.pending.empty();
+
+            polls[i].fd = connection.fd;
+            polls[i].events = POLLIN | (connection.out.empty() ? 0 : POLLOUT);
+            polls[i].revents = 0;
+        }
+        if (!sending && !outstanding) {
+            break;
+        }
+
+        int timeout_ms = int(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count()));
+        if (poll(polls.data(), polls.size(), timeout_ms) < 0) {
+            perror("poll");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < connections.size(); i++) {
+            Connection& connection = connections[i];
+            if (polls[i].revents & POLLOUT) {
+                //MSG_NOSIGNAL: a closed connection is reported here instead of killing the process with SIGPIPE
+                ssize_t bytes = send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+                if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("send");
+                    exit(1);
+                }
+                if (bytes > 0) {
+                    connection.out.erase(0, bytes);
+                }
+            }
+            if (polls[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t bytes = read(connection.fd, buffer, sizeof(buffer));
+                if (bytes == 0) {
+                    std::cout << "engine closed a connection" << std::endl;
+                    exit(1);
+                }
+                if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    perror("read");
+                    exit(1);
+                }
+                if (bytes > 0) {
+                    connection.in.append(buffer, bytes);
+                    take_responses(connection, Clock::now(), measure_from, result);
+                }
+            }
+        }
+    }
+}
+
+static void usage() {
+    std::cout << "usage: ./loadGen [--host=127.0.0.1] [--port=12345] [--connections=16] [--threads=4] [--rate=1000 (0: closed loop)]\n"
+                 "                 [--duration=10] [--warmup=2] [--mix=create:order:query:cancel (5:65:20:10)] [--symbols=100]\n"
+                 "                 [--zipf=1.0] [--price=100] [--spread=5] [--max-shares=100] [--seed=1]" << std::endl;
+    exit(1);
+}
+
+static void parse_options(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+            usage();
+        }
+        std::string name = arg.substr(2, equals - 2);
+        std::string value = arg.substr(equals + 1);
+
+        if (name == "host") options.host = value;
+        else if (name == "port") options.port = std::stoi(value);
+        else if (name == "connections") options.connections = std::max(1, std::stoi(value));
+        else if (name == "threads") options.threads = std::max(1, std::stoi(value));
+        else if (name == "rate") options.rate = std::max(0.0, std::stod(value));
+        else if (name == "duration") options.duration = std::stod(value);
+        else if (name == "warmup") options.warmup = std::stod(value);
+        else if (name == "symbols") options.symbols = std::max(1, std::stoi(value));
+        else if (name == "zipf") options.zipf = std::stod(value);
+        else if (name == "price") options.price = std::stoi(value);
+        else if (name == "spread") options.spread = std::max(0, std::stoi(value));
+        else if (name == "max-shares") options.max_shares = std::max(1, std::stoi(value));
+        else if (name == "seed") options.seed = std::stoul(value);
+        else if (name == "mix") {
+            if (sscanf(value.c_str(), "%d:%d:%d:%d", &options.mix[CREATE], &options.mix[ORDER], &options.mix[QUERY], &options.mix[CANCEL]) != 4 ||
+                options.mix[CREATE] + options.mix[ORDER] + options.mix[QUERY] + options.mix[CANCEL] <= 0) {
+                usage();
+            }
+        } else {
+            usage();
+        }
+    }
+    options.threads = std::min(options.threads, options.connections);
+}
+
+static void print_line(const char* name, const Histogram& histogram) {
+    if (histogram.total == 0) {
+        return;
+    }
+    printf("%-8s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, (unsigned long long)histogram.total,
+           histogram.percentile(0.5), histogram.percentile(0.9), histogram.percentile(0.99), histogram.percentile(0.999),
+           histogram.percentile(0.9999), histogram.max);
+}
+
+int main(int argc, char* argv[]) {
+    parse_options(argc, argv);
+
+    for (int i = 0; i < options.symbols; i++) {
+        symbol_names.push_back("S" + std::to_string(i));
+    }
+
+    //one funded account per connection, created before the clock starts; created accounts come after them
+    //from the clock, not the seed, so reruns against one engine don't collide
+    uint32_t base = 1000000 + uint32_t(std::chrono::system_clock::now().time_since_epoch().count() % 1000000) * 1000;
+    next_account = base + options.connections;
+    std::vector<std::vector<Connection>> per_thread(options.threads);
+    for (int i = 0; i < options.connections; i++) {
+        Connection connection;
+        connection.fd = connect_to_engine();
+        connection.account = base + i;
+        std::string response = round_trip(connection.fd, create_request(connection.account));
+        if (response.find("<error") != std::string::npos) {
+            std::cout << "setup failed:\n" << response << std::endl;
+            return 1;
+        }
+        per_thread[i % options.threads].push_back(std::move(connection));
+    }
+
+    std::vector<ThreadResult> results(options.threads);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < options.threads; i++) {
+        threads.emplace_back(run_thread, std::ref(per_thread[i]), start, std::ref(results[i]), options.seed * 7919 + i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count() - options.warmup;
+
+    ThreadResult total;
+    for (const ThreadResult& result : results) {
+        total.all.merge(result.all);
+        for (int type = 0; type < TYPE_COUNT; type++) {
+            total.by_type[type].merge(result.by_type[type]);
+        }
+        total.errors += result.errors;
+        total.sent += result.sent;
+        total.backlog_max = std::max(total.backlog_max, result.backlog_max);
+    }
+
+    printf("%s loop, %d connections on %d threads, target %.0f req/s, %d symbols (zipf %.2f)\n",
+           options.rate > 0 ? "open" : "closed", options.connections, options.threads, options.rate, options.symbols, options.zipf);
+    //errors include cancels of orders that filled meanwhile, which crossing prices make common
+    printf("measured %llu responses in %.2fs: %.0f req/s, %llu with errors, max backlog per connection %llu\n",
+           (unsigned long long)total.all.total, elapsed, total.all.total / std::max(elapsed, 1e-9),
+           (unsigned long long)total.errors, (unsigned long long)total.backlog_max);
+    printf("latency in us from the scheduled send%s:\n", options.rate > 0 ? " (corrected for coordinated omission)" : "");
+    printf("%-8s %10s %9s %9s %9s %9s %9s %9s\n", "type", "count", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    print_line("all", total.all);
+    for (int type = 0; type < TYPE_COUNT; type++) {
+        print_line(TYPE_NAMES[type], total.by_type[type]);
+    }
+
+    //one machine readable line for comparing runs
+    printf("{\"rate\":%.0f,\"throughput\":%.1f,\"count\":%llu,\"errors\":%llu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"p9999_us\":%.1f,\"max_us\":%.1f}\n",
+           options.rate, total.all.total / std::max(elapsed, 1e-9), (unsigned long long)total.all.total, (unsigned long long)total.errors,
+           total.all.percentile(0.5), total.all.percentile(0.99), total.all.percentile(0.999), total.all.percentile(0.9999), total.all.max);
+    return 0;
+}
@@ -0,0 +1,127 @@
+//compares the engine's XmlParser with tinyxml2 on the request shapes the test clients send: both have to
+//report the same elements, attributes and text, then each is timed parsing every shape repeatedly.
+//build: g++ -O3 -std=c++17 -I../docker-deploy/src/matching-engine -o parserBench parserBench.cpp ../docker-deploy/src/matching-engine/XmlParser.cpp -ltinyxml2
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tinyxml2.h"
+#include "XmlParser.h"
+
+//same event text for both parsers, e.g. <order sym=[AAPL]>{text}</order>
+class EventDump : public XmlHandler {
+public:
+    std::string out;
+
+    void start_element(std::string_view name, const std::vector<XmlAttribute>& attributes) override {
+        out += "<" + std::string(name);
+        for (const XmlAttribute& attribute : attributes) {
+            out += " " + std::string(attribute.name) + "=[" + std::string(attribute.value) + "]";
+        }
+        out += ">";
+    }
+
+    void end_element(std::string_view name) override {
+        out += "</" + std::string(name) + ">";
+    }
+
+    void text(std::string_view text) override {
+        out += "{" + std::string(text) + "}";
+    }
+};
+
+static void dump_node(const tinyxml2::XMLNode* node, std::string& out) {
+    for (const tinyxml2::XMLNode* child = node->FirstChild(); child != nullptr; child = child->NextSibling()) {
+        if (const tinyxml2::XMLElement* element = child->ToElement()) {
+            out += "<" + std::string(element->Name());
+            for (const tinyxml2::XMLAttribute* attribute = element->FirstAttribute(); attribute != nullptr; attribute = attribute->Next()) {
+                out += " " + std::string(attribute->Name()) + "=[" + attribute->Value() + "]";
+            }
+            out += ">";
+            dump_node(element, out);
+            out += "</" + std::string(element->Name()) + ">";
+        } else if (const tinyxml2::XMLText* text = child->ToText()) {
+            if (node->ToDocument() == nullptr) { //top level text isn't reported by XmlParser
+                out += "{" + std::string(text->Value()) + "}";
+            }
+        }
+    }
+}
+
+//request shapes of test.cpp and testMixed.cpp, plus the syntax they don't use
+static std::vector<std::string> shapes() {
+    std::string create =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<create>\n"
+        "  <account id=\"12\" balance=\"500000\"/>\n";
+    for (const char* stock : {"AAPL", "GOOG", "NVDA", "AMZN", "MSFT", "SBUX", "DIS", "GE"}) {
+        create += "  <symbol sym=\"" + std::string(stock) + "\">\n"
+                  "    <account id=\"12\">1000</account>\n"
+                  "  </symbol>\n";
+    }
+    create += "</create>\n";
+
+    return {
+        create,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<transactions id=\"12\">\n"
+        "  <order sym=\"AAPL\" amount=\"-40\" limit=\"125\"/>\n"
+        "</transactions>\n",
+        "<transactions id=\"12\"><cancel id=\"1043\"/></transactions>",
+        "<transactions id=\"12\"><query id=\"1043\"/></transactions>",
+        "<transactions id='7'>\n"
+        "  <!-- comment -->\n"
+        "  <order sym=\"A&amp;B\" amount = \"0x10\" limit=\"&#49;.5\"></order>\n"
+        "  <query id=\"3\">extra <![CDATA[<raw>]]> text &lt;&gt;</query>\n"
+        "</transactions>",
+    };
+}
+
+template <typename Parse>
+static double time_per_parse(const std::vector<std::string>& documents, int rounds, Parse parse) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (const std::string& document : documents) {
+            parse(document);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds / documents.size();
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200000;
+    std::vector<std::string> documents = shapes();
+
+    XmlParser parser;
+    bool equivalent = true;
+    for (const std::string& document : documents) {
+        EventDump events;
+        bool parsed = parser.parse(document.data(), document.size(), events);
+
+        tinyxml2::XMLDocument doc;
+        bool tinyxml_parsed = doc.Parse(document.data(), document.size()) == tinyxml2::XML_SUCCESS;
+        std::string tinyxml_events;
+        dump_node(&doc, tinyxml_events);
+
+        if (parsed != tinyxml_parsed || events.out != tinyxml_events) {
+            equivalent = false;
+            std::cout << "MISMATCH on:\n" << document << "\nXmlParser: " << events.out << "\ntinyxml2:  " << tinyxml_events << std::endl;
+        }
+    }
+    std::cout << (equivalent ? "equivalent output on all shapes" : "outputs differ") << std::endl;
+
+    XmlHandler ignore;
+    double sax = time_per_parse(documents, rounds, [&](const std::string& document) {
+        parser.parse(document.data(), document.size(), ignore);
+    });
+    double dom = time_per_parse(documents, rounds, [&](const std::string& document) {
+        tinyxml2::XMLDocument doc;
+        doc.Parse(document.data(), document.size());
+    });
+    std::cout << "XmlParser: " << sax << " ns/request" << std::endl;
+    std::cout << "tinyxml2:  " << dom << " ns/request" << std::endl;
+
+    return equivalent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+//testMixed over the binary protocol (port 12346): create account, add shares, then orders each followed by
+//a cancel or query.
+//build: g++ -O3 -std=c++17 -I../docker-deploy/src/matching-engine -o testBinary testBinary.cpp
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "BinaryProtocol.h"
+
+#define SERVER_IP   "127.0.0.1"
+#define SERVER_PORT 12346
+#define PRICE_SCALE 10000 //Price::SCALE
+
+template <typename Message>
+Message make_request(uint8_t type, uint32_t tag) {
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.header.length = sizeof(Message);
+    message.header.type = type;
+    message.header.tag = tag;
+    return message;
+}
+
+void set_symbol(char (&field)[BINARY_SYMBOL_LENGTH], const std::string& symbol) {
+    memcpy(field, symbol.data(), std::min(symbol.size(), sizeof(field)));
+}
+
+template <typename Message>
+void send_request(int sock, const Message& message) {
+    if (send(sock, &message, sizeof(message), 0) < 0) {
+        perror("Send failed");
+        close(sock);
+        exit(1);
+    }
+}
+
+bool read_exactly(int sock, char* out, size_t length) {
+    while (length > 0) {
+        ssize_t got = read(sock, out, length);
+        if (got <= 0) {
+            return false;
+        }
+        out += got;
+        length -= got;
+    }
+    return true;
+}
+
+//reads one response message into a zeroed Message; false if the connection is gone or the type is unexpected
+template <typename Message>
+bool receive(int sock, uint8_t type, Message& message) {
+    BinaryHeader header;
+    if (!read_exactly(sock, reinterpret_cast<char*>(&header), sizeof(header)) || header.length < sizeof(header)) {
+        std::cerr << "No response received or read failed.\n";
+        return false;
+    }
+    std::vector<char> body(header.length - sizeof(header));
+    if (!read_exactly(sock, body.data(), body.size())) {
+        std::cerr << "No response received or read failed.\n";
+        return false;
+    }
+
+    memset(&message, 0, sizeof(message));
+    memcpy(&message, &header, sizeof(header));
+    memcpy(reinterpret_cast<char*>(&message) + sizeof(header), body.data(), std::min(body.size(), sizeof(message) - sizeof(header)));
+    return header.type == type;
+}
+
+//result of a request, plus the status and executions that follow a successful cancel or query
+bool receive_result(int sock, bool with_status) {
+    BinaryResult result;
+    if (!receive(sock, BINARY_RESULT, result)) {
+        return false;
+    }
+    if (!result.ok) {
+        std::cout << "error (tag " << result.header.tag << "): " << std::string(result.error, strnlen(result.error, BINARY_ERROR_LENGTH)) << std::endl;
+        return false;
+    }
+    if (!with_status) {
+        return true;
+    }
+
+    BinaryStatus status;
+    if (!receive(sock, BINARY_STATUS, status)) {
+        return false;
+    }
+    std::cout << "order " << status.order_id << ": open " << status.open_shares << ", canceled " << status.canceled_shares;
+    for (uint32_t i = 0; i < status.executions; i++) {
+        BinaryExecution execution;
+        if (!receive(sock, BINARY_EXECUTION, execution)) {
+            return false;
+        }
+        std::cout << ", executed " << execution.shares << " at " << double(execution.price) / PRICE_SCALE;
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+void run_client(int sock, uint32_t aid, int order_count) {
+    std::vector<std::string> stocks = {"AAPL", "GOOG", "NVDA", "AMZN", "MSFT", "SBUX", "DIS", "GE"};
+    uint32_t tag = 0;
+
+    //create account and add shares
+    BinaryCreateAccount create = make_request<BinaryCreateAccount>(BINARY_CREATE_ACCOUNT, ++tag);
+    create.account_id = aid;
+    create.balance = int64_t(500000) * PRICE_SCALE;
+    send_request(sock, create);
+    receive_result(sock, false);
+
+    for (const std::string& stock : stocks) {
+        BinaryAddShares shares = make_request<BinaryAddShares>(BINARY_ADD_SHARES, ++tag);
+        shares.account_id = aid;
+        set_symbol(shares.symbol, stock);
+        shares.shares = 1000;
+        send_request(sock, shares);
+        receive_result(sock, false);
+    }
+
+    srand(time(NULL));
+
+    int remaining_shares = 1000;
+
+    for (int i = 0; i < order_count; i++) {
+        int amt = 10 + rand() % 10;
+        int lim = 95 + rand() % 10;
+
+        std::string stock = stocks[rand() % stocks.size()];
+
+        if (aid % 2 == 1) { //sell
+            if (amt > remaining_shares) amt = remaining_shares;
+            amt *= -1;
+            remaining_shares += amt; //subtract
+            if (remaining_shares <= 0) break; //no more to sell
+        }
+
+        //buy or sell
+        BinaryNewOrder order = make_request<BinaryNewOrder>(BINARY_NEW_ORDER, ++tag);
+        order.account_id = aid;
+        set_symbol(order.symbol, stock);
+        order.amount = amt;
+        order.limit = int64_t(lim) * PRICE_SCALE;
+        send_request(sock, order);
+
+        BinaryResult result;
+        if (!receive(sock, BINARY_RESULT, result)) {
+            break;
+        }
+        if (!result.ok) { //error, nothing to cancel or query
+            std::cout << "error: " << std::string(result.error, strnlen(result.error, BINARY_ERROR_LENGTH)) << std::endl;
+            continue;
+        }
+        std::cout << "opened " << result.order_id << std::endl;
+
+        //every even request should cancel, otherwise query
+        BinaryOrderRequest follow_up = make_request<BinaryOrderRequest>(i % 2 == 0 ? BINARY_CANCEL : BINARY_QUERY, ++tag);
+        follow_up.account_id = aid;
+        follow_up.order_id = result.order_id;
+        send_request(sock, follow_up);
+        receive_result(sock, true);
+    }
+
+    close(sock);
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        std::cout << "usage: ./testBinary <account_id> <number_of_requests>\n";
+        return EXIT_FAILURE;
+    }
+
+    uint32_t aid = std::stoul(argv[1]);
+    int request_num = std::stoi(argv[2]);
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+        std::cout << "Socket creation failed" << std::endl;
+        return 1;
+    }
+
+    struct sockaddr_in server_addr;
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0) {
+        std::cout << "Invalid address"  << std::endl;
+        close(sock);
+        return 1;
+    }
+
+    if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        std::cout << "Connection failed" << std::endl;
+        close(sock);
+        return 1;
+    }
+
+    run_client(sock, aid, request_num);
+
+    return 0;
+}